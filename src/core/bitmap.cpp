@@ -1,11 +1,89 @@
 #include "bitmap.h"
+#include "bitmap_simd.h"
 #include <iostream>
 #include <iomanip>
 #include <cstring>
+#include <algorithm>
+
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ != __ORDER_LITTLE_ENDIAN__
+#error "FreeBitmap 的按字存储依赖小端序与磁盘字节格式一致"
+#endif
+
+static_assert(sizeof(std::atomic<uint64_t>) == sizeof(uint64_t) && std::atomic<uint64_t>::is_always_lock_free,
+              "位图字需要与 uint64_t 布局一致，扫描内核与序列化按普通整数数组访问");
+
+namespace {
+    constexpr uint32_t WORD_BITS = 64;
+    constexpr uint64_t FULL_WORD = ~0ULL;
+
+    // 字内从第bit位开始的n个连续位
+    uint64_t range_mask(const uint32_t bit, const uint32_t n) {
+        return n >= WORD_BITS ? FULL_WORD : ((1ULL << n) - 1) << bit;
+    }
+
+    // 字内第一段长度不小于count的连续0位的起始位置，没有返回UINT32_MAX
+    uint32_t find_zero_run(const uint64_t word, const uint32_t count) {
+        // 倍增：runs 的第i位为1表示从第i位起已有len个连续空闲位
+        uint64_t runs = ~word;
+        uint32_t len = 1;
+        while (len < count && runs != 0) {
+            const uint32_t step = std::min(len, count - len);
+            runs &= runs >> step;
+            len += step;
+        }
+        return runs == 0 ? UINT32_MAX : static_cast<uint32_t>(__builtin_ctzll(runs));
+    }
+}
 
 // 构造函数：现在只进行最基本的初始化
 FreeBitmap::FreeBitmap(const uint32_t total_blocks)
-    : total_blocks_(0), free_blocks_(0), cache_(nullptr) {
+    : total_blocks_(0), bitmap_blocks_(0), first_data_block_(0), cache_(nullptr) {
+}
+
+uint32_t FreeBitmap::bitmap_blocks_for(const uint32_t total_blocks) {
+    return (total_blocks + BITMAP_BLOCK_BITS - 1) / BITMAP_BLOCK_BITS;
+}
+
+// 计算磁盘布局：[超级块][位图块][保留块(inode位图与inode表)][数据块...]
+void FreeBitmap::setup_layout(const uint32_t total_blocks, const uint32_t reserved_blocks, const uint32_t bitmap_start) {
+    total_blocks_ = total_blocks;
+    bitmap_start_ = bitmap_start;
+    bitmap_blocks_ = bitmap_blocks_for(total_blocks_);
+    first_data_block_ = static_cast<uint32_t>(
+        std::min<uint64_t>(total_blocks_, static_cast<uint64_t>(bitmap_start_) + bitmap_blocks_ + reserved_blocks));
+    bitmap_ = std::vector<std::atomic<uint64_t>>((total_blocks_ + WORD_BITS - 1) / WORD_BITS);
+
+    // 按 BITMAP_GROUP_BLOCKS 切分分配组
+    groups_.clear();
+    for (uint64_t start = 0; start < total_blocks_; start += BITMAP_GROUP_BLOCKS) {
+        auto group = std::make_unique<AllocationGroup>();
+        group->start_block = static_cast<uint32_t>(start);
+        group->end_block = static_cast<uint32_t>(std::min<uint64_t>(start + BITMAP_GROUP_BLOCKS, total_blocks_));
+        group->rotor = group->start_block;
+        groups_.push_back(std::move(group));
+    }
+}
+
+void FreeBitmap::reserve_metadata_blocks() {
+    // 直接置位，空闲计数与区段索引由随后的 rebuild_extent_index 重新计算
+    for (uint32_t block = 0; block < first_data_block_; ++block) {
+        if (is_block_free(block)) {
+            bitmap_[block / WORD_BITS].fetch_or(1ULL << (block % WORD_BITS), std::memory_order_relaxed);
+            group_of(block).dirty = true;
+        }
+    }
+}
+
+AllocationGroup& FreeBitmap::group_of(const uint32_t block_no) const {
+    return *groups_[block_no / BITMAP_GROUP_BLOCKS];
+}
+
+size_t FreeBitmap::preferred_group() const {
+    // 线程按首次分配的先后依次编号，并发创建文件时各自在自己的组内分配；
+    // 第一个（单线程时唯一的）线程总是从0号组开始，保证放置位置在各次运行间确定
+    static std::atomic<size_t> next_thread_index{0};
+    static thread_local const size_t thread_index = next_thread_index.fetch_add(1, std::memory_order_relaxed);
+    return thread_index % groups_.size();
 }
 
 // 内部的初始化逻辑
@@ -13,112 +91,714 @@ void FreeBitmap::initialize() {
     // ReadWriteLock::WriteGuard guard(rw_lock_);
 
     // 重置所有位为0（空闲状态）
-    std::fill(bitmap_.begin(), bitmap_.end(), 0);
-    free_blocks_ = total_blocks_;
-    // 标记保留块 (块0用于Bitmap自身, 块1用于Inode Table)
-    if (total_blocks_ > 1) {
-        set_block_status(0, true);
-        set_block_status(1, true);
+    for (auto& word : bitmap_) {
+        word.store(0, std::memory_order_relaxed);
     }
+    mark_tail_padding();
+    // 标记保留块（位图自身与Inode表）
+    reserve_metadata_blocks();
+    // 整张位图都需要写出
+    for (const auto& group : groups_) {
+        group->dirty = true;
+    }
+    rebuild_extent_index();
 }
 
 bool FreeBitmap::is_block_free(const uint32_t block_no) const {
     if (block_no >= total_blocks_) {
         return false;
     }
-    const uint32_t byte_index = block_no / 8;
-    const uint32_t bit_index = block_no % 8;
-    return !(bitmap_[byte_index] & (1 << bit_index));
+    const uint64_t word = bitmap_[block_no / WORD_BITS].load(std::memory_order_acquire);
+    return !((word >> (block_no % WORD_BITS)) & 1ULL);
 }
 
-void FreeBitmap::set_block_status(const uint32_t block_no, const bool allocated) {
+bool FreeBitmap::set_block_status(const uint32_t block_no, const bool allocated) {
     if (block_no >= total_blocks_) {
-        return;
+        return false;
     }
 
-    const uint32_t byte_index = block_no / 8;
-    const uint32_t bit_index = block_no % 8;
-    const uint8_t mask = 1 << bit_index;
-    const bool was_free = is_block_free(block_no);
+    // 调用方需持有块所在分配组的锁；位本身用原子操作修改，与无锁路径互不覆盖
+    AllocationGroup& group = group_of(block_no);
+    std::atomic<uint64_t>& word = bitmap_[block_no / WORD_BITS];
+    const uint64_t mask = 1ULL << (block_no % WORD_BITS);
+    const uint64_t old = allocated ? word.fetch_or(mask, std::memory_order_acq_rel)
+                                   : word.fetch_and(~mask, std::memory_order_acq_rel);
+    const bool was_free = !(old & mask);
+    if (allocated != was_free) {
+        return false; // 状态没有变化
+    }
 
     if (allocated) {
-        if (was_free && free_blocks_ > 0) {
-            bitmap_[byte_index] |= mask;
-            free_blocks_--;
+        // 并发模式下组计数可能落后于位图，不让它下溢，过期标记会在下次加锁时修正
+        if (group.free_blocks > 0) {
+            group.free_blocks--;
         }
+        free_blocks_.add(-1);
+        group.index.remove(block_no, 1);
     } else {
-        if (!was_free) {
-            bitmap_[byte_index] &= ~mask;
-            free_blocks_++;
-        }
+        group.free_blocks++;
+        free_blocks_.add(1);
+        group.index.insert(block_no, 1);
     }
+    group.dirty = true;
+    return true;
 }
 
-uint32_t FreeBitmap::find_first_free_block() const {
-    for (uint32_t block = 2; block < total_blocks_; ++block) { // 从块2开始查找
-        if (is_block_free(block)) {
-            return block;
+uint64_t FreeBitmap::reserved_mask(const size_t w) const {
+    const uint64_t first_bit = static_cast<uint64_t>(w) * WORD_BITS;
+    if (first_bit >= first_data_block_) {
+        return 0;
+    }
+    const uint64_t reserved = first_data_block_ - first_bit;
+    return reserved >= WORD_BITS ? FULL_WORD : (1ULL << reserved) - 1;
+}
+
+// 读取第w个字，保留区内的块按已分配处理
+uint64_t FreeBitmap::load_word(const size_t w) const {
+    return bitmap_[w].load(std::memory_order_acquire) | reserved_mask(w);
+}
+
+// 扫描内核按普通整数读取位图：非并发模式下调用方持有组锁，读到的就是准确值；
+// 并发模式下读到的只是提示，真正占用时由CAS校验
+const uint64_t* FreeBitmap::raw_words() const {
+    return reinterpret_cast<const uint64_t*>(bitmap_.data());
+}
+
+uint32_t FreeBitmap::free_count() const {
+    return static_cast<uint32_t>(std::clamp<int64_t>(free_blocks_.load(), 0, total_blocks_));
+}
+
+uint32_t FreeBitmap::available_count() const {
+    const uint32_t free = free_count();
+    const uint32_t reserved = reserved_blocks_.load(std::memory_order_relaxed);
+    return free > reserved ? free - reserved : 0;
+}
+
+bool FreeBitmap::reserve_blocks(const uint32_t count) {
+    uint32_t reserved = reserved_blocks_.load(std::memory_order_relaxed);
+    do {
+        if (static_cast<uint64_t>(reserved) + count > free_count()) {
+            return false;
         }
+    } while (!reserved_blocks_.compare_exchange_weak(reserved, reserved + count, std::memory_order_relaxed));
+    return true;
+}
+
+void FreeBitmap::release_reservation(const uint32_t count) {
+    uint32_t reserved = reserved_blocks_.load(std::memory_order_relaxed);
+    while (!reserved_blocks_.compare_exchange_weak(reserved, reserved - std::min(reserved, count),
+                                                   std::memory_order_relaxed)) {
     }
-    return UINT32_MAX;
+}
+
+uint32_t FreeBitmap::find_free_in_group_locked(const AllocationGroup& group) const {
+    // 从游标所在字扫描到组尾，再从组首扫描到游标：由SIMD内核跳过全满的字，再用ctz定位第一个0位
+    const BitmapKernels& kernels = bitmap_kernels();
+    const size_t first_word = group.start_block / WORD_BITS;
+    const size_t end_word = (group.end_block + WORD_BITS - 1) / WORD_BITS;
+    const size_t rotor_word = std::clamp<size_t>(group.rotor.load(std::memory_order_relaxed) / WORD_BITS,
+                                                 first_word, end_word - 1);
+
+    auto scan = [&](size_t w, const size_t end) -> uint32_t {
+        while ((w = kernels.find_not_full(raw_words(), w, end)) < end) {
+            const uint64_t word = load_word(w);
+            if (word != FULL_WORD) {
+                return static_cast<uint32_t>(w * WORD_BITS + __builtin_ctzll(~word));
+            }
+            ++w;
+        }
+        return UINT32_MAX;
+    };
+
+    const uint32_t block = scan(rotor_word, end_word);
+    return block != UINT32_MAX ? block : scan(first_word, rotor_word);
 }
 
 uint32_t FreeBitmap::find_consecutive_free_blocks(const uint32_t count) const {
-    if (count == 0 || count > free_blocks_) {
+    if (count == 0 || count > free_count()) {
         return UINT32_MAX;
     }
-    for (uint32_t start = 2; start <= total_blocks_ - count; ++start) {
-        bool found = true;
-        for (uint32_t i = 0; i < count; ++i) {
-            if (!is_block_free(start + i)) {
-                found = false;
-                start += i; // 优化
+
+    // 按字扫描维护当前空闲游程：不在游程中时用内核跳过全满的字，
+    // 连续的全空字由内核一次跨过，混合字用ctz在空闲段与已分配段之间跳跃
+    const BitmapKernels& kernels = bitmap_kernels();
+    uint64_t run_start = 0;
+    uint64_t run_length = 0;
+    const size_t word_count = bitmap_.size();
+    size_t w = first_data_block_ / WORD_BITS;
+    while (w < word_count) {
+        if (run_length == 0) {
+            w = kernels.find_not_full(raw_words(), w, word_count);
+            if (w == word_count) {
                 break;
             }
         }
-        if (found) {
-            return start;
+
+        const uint64_t word = load_word(w);
+        if (word == 0) {
+            const size_t end = kernels.find_not_empty(raw_words(), w, word_count);
+            if (run_length == 0) {
+                run_start = w * WORD_BITS;
+            }
+            run_length += (end - w) * WORD_BITS;
+            if (run_length >= count) {
+                return static_cast<uint32_t>(run_start);
+            }
+            w = end;
+            continue;
+        }
+        if (word == FULL_WORD) {
+            run_length = 0;
+            ++w;
+            continue;
+        }
+
+        const uint64_t free_bits = ~word;
+        uint32_t pos = 0;
+        while (pos < WORD_BITS) {
+            const uint64_t remaining = free_bits >> pos;
+            if (remaining == 0) {
+                run_length = 0; // 字内剩余位全部已分配
+                break;
+            }
+            const uint32_t skip = __builtin_ctzll(remaining);
+            if (skip > 0) {
+                run_length = 0;
+                pos += skip;
+            }
+            // 右移补入的0在取反后表现为已分配，保证段长不越过字尾
+            const uint32_t segment = __builtin_ctzll(~(free_bits >> pos));
+            if (run_length == 0) {
+                run_start = w * WORD_BITS + pos;
+            }
+            run_length += segment;
+            if (run_length >= count) {
+                return static_cast<uint32_t>(run_start);
+            }
+            pos += segment;
         }
+        ++w;
     }
     return UINT32_MAX;
 }
 
-bool FreeBitmap::allocate_block(uint32_t& block_no) {
-    // ReadWriteLock::WriteGuard guard(rw_lock_);
-    if (free_blocks_ == 0) return false;
-    const uint32_t free_block = find_first_free_block();
-    if (free_block == UINT32_MAX) return false;
-    set_block_status(free_block, true);
-    block_no = free_block;
+void FreeBitmap::rebuild_extent_index() {
+    // 调用方需保证没有并发分配
+    int64_t total_free = 0;
+    for (const auto& group : groups_) {
+        rebuild_group_locked(*group);
+        total_free += group->free_blocks;
+    }
+    free_blocks_.reset(total_free);
+    rebuild_buddy_index();
+}
+
+void FreeBitmap::rebuild_buddy_index() {
+    if (!buddy_) {
+        return;
+    }
+    buddy_->reset(total_blocks_);
+    for (const auto& group : groups_) {
+        for (const auto& [start, length] : group->index.extents()) {
+            buddy_->insert(start, length);
+        }
+    }
+}
+
+void FreeBitmap::rebuild_group_locked(AllocationGroup& group) const {
+    // 与 find_consecutive_free_blocks 相同的按字扫描，组按字对齐，游程不会越出本组
+    group.stale.store(false, std::memory_order_release);
+    group.index.clear();
+    group.free_blocks = 0;
+
+    const BitmapKernels& kernels = bitmap_kernels();
+    const size_t end_word = (group.end_block + WORD_BITS - 1) / WORD_BITS;
+    uint64_t run_start = 0;
+    uint64_t run_length = 0;
+    auto close_run = [&]() {
+        if (run_length > 0) {
+            group.index.insert(static_cast<uint32_t>(run_start), static_cast<uint32_t>(run_length));
+            group.free_blocks += static_cast<uint32_t>(run_length);
+            run_length = 0;
+        }
+    };
+
+    size_t w = std::max(group.start_block, first_data_block_) / WORD_BITS;
+    while (w < end_word) {
+        if (run_length == 0) {
+            w = kernels.find_not_full(raw_words(), w, end_word);
+            if (w == end_word) {
+                break;
+            }
+        }
+
+        const uint64_t word = load_word(w);
+        if (word == 0) {
+            const size_t end = kernels.find_not_empty(raw_words(), w, end_word);
+            if (run_length == 0) {
+                run_start = w * WORD_BITS;
+            }
+            run_length += (end - w) * WORD_BITS;
+            w = end;
+            continue;
+        }
+        if (word == FULL_WORD) {
+            close_run();
+            ++w;
+            continue;
+        }
+
+        const uint64_t free_bits = ~word;
+        uint32_t pos = 0;
+        while (pos < WORD_BITS) {
+            const uint64_t remaining = free_bits >> pos;
+            if (remaining == 0) {
+                close_run();
+                break;
+            }
+            const uint32_t skip = __builtin_ctzll(remaining);
+            if (skip > 0) {
+                close_run();
+                pos += skip;
+            }
+            const uint32_t segment = __builtin_ctzll(~(free_bits >> pos));
+            if (run_length == 0) {
+                run_start = w * WORD_BITS + pos;
+            }
+            run_length += segment;
+            pos += segment;
+        }
+        ++w;
+    }
+    close_run();
+}
+
+void FreeBitmap::refresh_group_locked(AllocationGroup& group) const {
+    // 先清除过期标记再重建，重建期间发生的无锁修改会重新标记
+    if (group.stale.load(std::memory_order_acquire)) {
+        rebuild_group_locked(group);
+    }
+}
+
+uint32_t FreeBitmap::count_free_blocks() const {
+    const uint64_t used_bits = bitmap_kernels().count_ones(raw_words(), 0, bitmap_.size());
+    // 扣除恒为1的填充位
+    const uint64_t padding = static_cast<uint64_t>(bitmap_.size()) * WORD_BITS - total_blocks_;
+    return static_cast<uint32_t>(total_blocks_ - (used_bits - padding));
+}
+
+std::vector<uint32_t> FreeBitmap::get_region_free_counts(const uint32_t region_blocks) const {
+    // 区域大小按整字对齐，便于直接使用内核按256位通道统计
+    const size_t region_words = std::max<size_t>(1, region_blocks / WORD_BITS);
+    const BitmapKernels& kernels = bitmap_kernels();
+    std::vector<uint32_t> counts;
+    for (size_t begin = 0; begin < bitmap_.size(); begin += region_words) {
+        const size_t end = std::min(begin + region_words, bitmap_.size());
+        const uint64_t bits = (end - begin) * WORD_BITS;
+        const uint64_t used = kernels.count_ones(raw_words(), begin, end);
+        counts.push_back(static_cast<uint32_t>(bits - used));
+    }
+    return counts;
+}
+
+FragmentationStats FreeBitmap::get_fragmentation() const {
+    FragmentationStats stats;
+    stats.histogram.assign(BITMAP_FRAG_BUCKETS, 0);
+
+    uint32_t run = 0;
+    const auto close_run = [&stats, &run]() {
+        if (run == 0) {
+            return;
+        }
+        const uint32_t bucket = std::min<uint32_t>(31 - __builtin_clz(run), BITMAP_FRAG_BUCKETS - 1);
+        ++stats.histogram[bucket];
+        ++stats.free_extents;
+        stats.free_blocks += run;
+        stats.largest_extent = std::max(stats.largest_extent, run);
+        run = 0;
+    };
+
+    // 整字为空或全满时整体处理，只有混合字才逐位检查（尾部填充位为1，不会计入）
+    for (size_t w = 0; w < bitmap_.size(); ++w) {
+        const uint64_t word = load_word(w);
+        if (word == 0) {
+            run += WORD_BITS;
+        } else if (word == FULL_WORD) {
+            close_run();
+        } else {
+            for (uint32_t bit = 0; bit < WORD_BITS; ++bit) {
+                if (word >> bit & 1) {
+                    close_run();
+                } else {
+                    ++run;
+                }
+            }
+        }
+    }
+    close_run();
+    return stats;
+}
+
+void FreeBitmap::mark_tail_padding() {
+    const uint32_t tail_bits = total_blocks_ % WORD_BITS;
+    if (tail_bits != 0 && !bitmap_.empty()) {
+        bitmap_.back().fetch_or(FULL_WORD << tail_bits, std::memory_order_relaxed);
+    }
+}
+
+bool FreeBitmap::set_range_bits(const uint32_t start, const uint32_t count) {
+    const uint32_t end = start + count;
+    for (uint32_t block = start; block < end;) {
+        const uint32_t bit = block % WORD_BITS;
+        const uint32_t n = std::min(WORD_BITS - bit, end - block);
+        const uint64_t mask = range_mask(bit, n);
+        std::atomic<uint64_t>& word = bitmap_[block / WORD_BITS];
+        uint64_t expected = word.load(std::memory_order_relaxed);
+        do {
+            if (expected & mask) {
+                // 已被其他线程抢先占用，撤销本次已置位的部分
+                clear_range_bits(start, block, nullptr);
+                return false;
+            }
+        } while (!word.compare_exchange_weak(expected, expected | mask,
+                                             std::memory_order_acq_rel, std::memory_order_relaxed));
+        block += n;
+    }
     return true;
 }
 
-bool FreeBitmap::allocate_consecutive_blocks(const uint32_t count, uint32_t& start_block) {
-    // ReadWriteLock::WriteGuard guard(rw_lock_);
-    if (count == 0 || count > free_blocks_) return false;
-    const uint32_t start = find_consecutive_free_blocks(count);
-    if (start == UINT32_MAX) return false;
-    for (uint32_t i = 0; i < count; ++i) {
-        set_block_status(start + i, true);
+uint32_t FreeBitmap::clear_range_bits(const uint32_t start, const uint32_t end, FreeExtentIndex* index) {
+    // 按字原子清除，只有真正由已分配变为空闲的位才计数并加入索引，重复释放不会被计入两次
+    uint32_t freed_total = 0;
+    uint32_t run_start = 0;
+    uint32_t run_length = 0;
+    for (uint32_t block = start; block < end;) {
+        const uint32_t w = block / WORD_BITS;
+        const uint32_t bit = block % WORD_BITS;
+        const uint32_t n = std::min(WORD_BITS - bit, end - block);
+        const uint64_t mask = range_mask(bit, n);
+        uint64_t freed = bitmap_[w].fetch_and(~mask, std::memory_order_acq_rel) & mask;
+        freed_total += __builtin_popcountll(freed);
+
+        while (index && freed != 0) {
+            const uint32_t pos = __builtin_ctzll(freed);
+            const uint64_t shifted = freed >> pos;
+            const uint32_t len = ~shifted == 0 ? WORD_BITS - pos : __builtin_ctzll(~shifted);
+            const uint32_t run_block = w * WORD_BITS + pos;
+            if (run_length > 0 && run_start + run_length == run_block) {
+                run_length += len;
+            } else {
+                index->insert(run_start, run_length);
+                run_start = run_block;
+                run_length = len;
+            }
+            freed = pos + len >= WORD_BITS ? 0 : freed & (FULL_WORD << (pos + len));
+        }
+        block += n;
+    }
+    if (index) {
+        index->insert(run_start, run_length);
+    }
+    return freed_total;
+}
+
+bool FreeBitmap::claim_range_locked(AllocationGroup& group, const uint32_t start, const uint32_t count) {
+    if (!set_range_bits(start, count)) {
+        group.stale.store(true, std::memory_order_release);
+        return false;
+    }
+    group.index.remove(start, count);
+    group.free_blocks -= std::min(group.free_blocks, count);
+    free_blocks_.add(-static_cast<int64_t>(count));
+    group.dirty = true;
+    return true;
+}
+
+void FreeBitmap::release_range_locked(AllocationGroup& group, const uint32_t start, const uint32_t end) {
+    const uint32_t freed = clear_range_bits(start, end, &group.index);
+    group.free_blocks += freed;
+    free_blocks_.add(freed);
+    group.dirty = true;
+}
+
+void FreeBitmap::release_range_lockfree(AllocationGroup& group, const uint32_t start, const uint32_t end) {
+    const uint32_t freed = clear_range_bits(start, end, nullptr);
+    if (freed > 0) {
+        free_blocks_.add(freed);
+        group.stale.store(true, std::memory_order_release);
+        group.dirty = true;
+    }
+}
+
+bool FreeBitmap::try_allocate_lockfree(const uint32_t count, const uint32_t goal, uint32_t& start_block) {
+    // 从目标块（或本线程偏好组的游标）所在的字开始，逐字查找足够长的0位段并CAS置位
+    const bool has_goal = goal >= first_data_block_ && goal < total_blocks_;
+    const size_t group_count = groups_.size();
+    const size_t preferred = has_goal ? goal / BITMAP_GROUP_BLOCKS : preferred_group();
+    for (size_t i = 0; i < group_count; ++i) {
+        AllocationGroup& group = *groups_[(preferred + i) % group_count];
+        const size_t first_word = group.start_block / WORD_BITS;
+        const size_t end_word = (group.end_block + WORD_BITS - 1) / WORD_BITS;
+        const size_t word_count = end_word - first_word;
+        const uint32_t hint = i == 0 && has_goal ? goal : group.rotor.load(std::memory_order_relaxed);
+        const size_t hint_word = std::clamp<size_t>(hint / WORD_BITS, first_word, end_word - 1);
+
+        for (size_t k = 0; k < word_count; ++k) {
+            size_t w = hint_word + k;
+            if (w >= end_word) {
+                w -= word_count;
+            }
+            std::atomic<uint64_t>& word = bitmap_[w];
+            uint64_t current = word.load(std::memory_order_relaxed);
+            uint32_t pos;
+            while ((pos = find_zero_run(current | reserved_mask(w), count)) != UINT32_MAX) {
+                if (word.compare_exchange_weak(current, current | range_mask(pos, count),
+                                               std::memory_order_acq_rel, std::memory_order_relaxed)) {
+                    const auto block = static_cast<uint32_t>(w * WORD_BITS + pos);
+                    free_blocks_.add(-static_cast<int64_t>(count));
+                    group.stale.store(true, std::memory_order_release);
+                    group.dirty = true;
+                    group.rotor.store(block + count, std::memory_order_relaxed);
+                    start_block = block;
+                    return true;
+                }
+                // CAS失败时 current 已被更新为最新值，重新查找
+            }
+        }
+    }
+    return false;
+}
+
+bool FreeBitmap::allocate_block(uint32_t& block_no) {
+    // 预留给延迟分配的块不能被普通分配占用
+    if (available_count() == 0) return false;
+    if (buddy_) {
+        return allocate_buddy(1, block_no, UINT32_MAX);
+    }
+    if (is_concurrent_mode()) {
+        return try_allocate_lockfree(1, UINT32_MAX, block_no);
+    }
+
+    // 先在本线程偏好的组内分配，组满再依次尝试其他组
+    const size_t group_count = groups_.size();
+    const size_t preferred = preferred_group();
+    for (size_t i = 0; i < group_count; ++i) {
+        AllocationGroup& group = *groups_[(preferred + i) % group_count];
+        LockGuard<SimpleMutex> lock(group.lock);
+        refresh_group_locked(group);
+        if (group.free_blocks == 0) continue;
+        uint32_t free_block;
+        while ((free_block = find_free_in_group_locked(group)) != UINT32_MAX) {
+            if (set_block_status(free_block, true)) {
+                group.rotor.store(free_block + 1, std::memory_order_relaxed);
+                block_no = free_block;
+                return true;
+            }
+        }
+    }
+    return false;
+}
+
+bool FreeBitmap::allocate_consecutive_blocks(const uint32_t count, uint32_t& start_block, const uint32_t goal) {
+    if (count == 0 || count > available_count()) return false;
+    if (buddy_) {
+        return allocate_buddy(count, start_block, goal);
+    }
+
+    // 并发模式下小段分配先走无锁路径
+    if (is_concurrent_mode() && count <= BITMAP_LOCKFREE_MAX_RUN &&
+        try_allocate_lockfree(count, goal, start_block)) {
+        return true;
+    }
+
+    // 有目标块时从目标块所在组开始，在组内从目标块向后就近查找；
+    // 否则从本线程偏好的组开始。附近放不下时用区段索引做最佳适配，不再扫描位图
+    if (count <= BITMAP_GROUP_BLOCKS) {
+        const bool has_goal = goal >= first_data_block_ && goal < total_blocks_;
+        const size_t group_count = groups_.size();
+        const size_t preferred = has_goal ? goal / BITMAP_GROUP_BLOCKS : preferred_group();
+        for (size_t i = 0; i < group_count; ++i) {
+            AllocationGroup& group = *groups_[(preferred + i) % group_count];
+            LockGuard<SimpleMutex> lock(group.lock);
+            while (true) {
+                uint32_t start = UINT32_MAX;
+                if (group.free_blocks >= count && has_goal) {
+                    const uint32_t local_goal = i == 0 ? goal : group.start_block;
+                    start = group.index.nearest_fit(count, local_goal, BITMAP_GOAL_PROBES);
+                }
+                if (group.free_blocks >= count && start == UINT32_MAX) {
+                    start = group.index.best_fit(count);
+                }
+                if (start == UINT32_MAX) {
+                    // 过期的索引可能漏掉无锁路径释放的块，重建后再找一次
+                    if (!group.stale.load(std::memory_order_acquire)) break;
+                    rebuild_group_locked(group);
+                    continue;
+                }
+                if (claim_range_locked(group, start, count)) {
+                    group.rotor.store(start + count, std::memory_order_relaxed);
+                    start_block = start;
+                    return true;
+                }
+                // 候选区段已被无锁路径占用，重建本组索引后重试
+                rebuild_group_locked(group);
+            }
+        }
+    }
+
+    // 组内放不下（超过一组或空闲区段跨越组边界）时退回全局扫描
+    return allocate_across_groups(count, start_block);
+}
+
+bool FreeBitmap::allocate_across_groups(const uint32_t count, uint32_t& start_block) {
+    // 按组号递增的顺序锁住所有组，单组路径一次只持有一把组锁，不会形成环路等待
+    std::vector<UniqueLock<SimpleMutex>> locks;
+    locks.reserve(groups_.size());
+    for (const auto& group : groups_) {
+        locks.emplace_back(group->lock);
+    }
+
+    // 直接扫描位图查找，组索引即使过期也只是提示，占用结果以CAS为准
+    uint32_t start;
+    while ((start = find_consecutive_free_blocks(count)) != UINT32_MAX) {
+        const uint32_t end = start + count;
+        uint32_t block = start;
+        while (block < end) {
+            AllocationGroup& group = group_of(block);
+            const uint32_t piece_end = std::min(end, group.end_block);
+            if (!claim_range_locked(group, block, piece_end - block)) {
+                break;
+            }
+            block = piece_end;
+        }
+        if (block == end) {
+            start_block = start;
+            return true;
+        }
+
+        // 某段被无锁路径抢先占用：退还已占用的部分后重新查找
+        for (uint32_t undo = start; undo < block;) {
+            AllocationGroup& group = group_of(undo);
+            const uint32_t piece_end = std::min(block, group.end_block);
+            release_range_locked(group, undo, piece_end);
+            undo = piece_end;
+        }
     }
+    return false;
+}
+
+bool FreeBitmap::allocate_buddy(const uint32_t count, uint32_t& start_block, const uint32_t goal) {
+    LockGuard<SimpleMutex> buddy_lock(buddy_lock_);
+    uint32_t start = buddy_->find(count, goal);
+    if (start == UINT32_MAX) {
+        // 没有足够大的对齐块时退回位图扫描，任意位置的连续空闲段都可用
+        start = find_consecutive_free_blocks(count);
+        if (start == UINT32_MAX) return false;
+    }
+
+    // 伙伴模式下所有修改都在伙伴锁下进行，位图与伙伴索引一致，占用不会冲突
+    const uint32_t end = start + count;
+    for (uint32_t block = start; block < end;) {
+        AllocationGroup& group = group_of(block);
+        const uint32_t piece_end = std::min(end, group.end_block);
+        LockGuard<SimpleMutex> lock(group.lock);
+        if (!claim_range_locked(group, block, piece_end - block)) {
+            std::cerr << "伙伴索引与位图不一致: 块 " << block << " 已被占用" << std::endl;
+            return false;
+        }
+        block = piece_end;
+    }
+    buddy_->remove(start, count);
     start_block = start;
     return true;
 }
 
+void FreeBitmap::free_buddy(const uint32_t start_block, const uint32_t end_block) {
+    LockGuard<SimpleMutex> buddy_lock(buddy_lock_);
+    for (uint32_t block = start_block; block < end_block;) {
+        AllocationGroup& group = group_of(block);
+        const uint32_t piece_end = std::min(end_block, group.end_block);
+        // 只归还真正由已分配变为空闲的游程，重复释放不会让伙伴索引多出块
+        FreeExtentIndex freed;
+        {
+            LockGuard<SimpleMutex> lock(group.lock);
+            const uint32_t count = clear_range_bits(block, piece_end, &freed);
+            for (const auto& [start, length] : freed.extents()) {
+                group.index.insert(start, length);
+            }
+            group.free_blocks += count;
+            free_blocks_.add(count);
+            group.dirty = true;
+        }
+        for (const auto& [start, length] : freed.extents()) {
+            buddy_->insert(start, length);
+        }
+        block = piece_end;
+    }
+}
+
 void FreeBitmap::free_block(const uint32_t block_no) {
-    // ReadWriteLock::WriteGuard guard(rw_lock_);
-    if (block_no < 2 || block_no >= total_blocks_) return;
+    if (block_no < first_data_block_ || block_no >= total_blocks_) return;
+    if (buddy_) {
+        free_buddy(block_no, block_no + 1);
+        return;
+    }
+    AllocationGroup& group = group_of(block_no);
+    if (is_concurrent_mode()) {
+        release_range_lockfree(group, block_no, block_no + 1);
+        return;
+    }
+    LockGuard<SimpleMutex> lock(group.lock);
     set_block_status(block_no, false);
 }
 
 void FreeBitmap::free_consecutive_blocks(const uint32_t start_block, const uint32_t count) {
-    // ReadWriteLock::WriteGuard guard(rw_lock_);
     if (start_block >= total_blocks_ || count == 0) return;
-    const uint32_t end_block = std::min(start_block + count, total_blocks_);
-    for (uint32_t block = start_block; block < end_block; ++block) {
-        if (block >= 2) {
-            set_block_status(block, false);
+    const auto end_block = static_cast<uint32_t>(
+        std::min<uint64_t>(static_cast<uint64_t>(start_block) + count, total_blocks_));
+    uint32_t block = std::max(start_block, first_data_block_);
+    if (buddy_) {
+        free_buddy(block, end_block);
+        return;
+    }
+
+    // 按组逐段释放，每段只持有所在组的锁；并发模式下直接原子清位
+    const bool lockfree = is_concurrent_mode();
+    while (block < end_block) {
+        AllocationGroup& group = group_of(block);
+        const uint32_t piece_end = std::min(end_block, group.end_block);
+        if (lockfree) {
+            release_range_lockfree(group, block, piece_end);
+        } else {
+            LockGuard<SimpleMutex> lock(group.lock);
+            release_range_locked(group, block, piece_end);
         }
+        block = piece_end;
+    }
+}
+
+void FreeBitmap::set_concurrent_mode(const bool enabled) {
+    // 切换时锁住所有组，并重建在无锁模式下过期的组索引
+    std::vector<UniqueLock<SimpleMutex>> locks;
+    locks.reserve(groups_.size());
+    for (const auto& group : groups_) {
+        locks.emplace_back(group->lock);
+    }
+    concurrent_.store(enabled, std::memory_order_release);
+    for (const auto& group : groups_) {
+        refresh_group_locked(*group);
+    }
+}
+
+void FreeBitmap::set_allocator(const AllocatorKind kind) {
+    LockGuard<SimpleMutex> buddy_lock(buddy_lock_);
+    if (kind == AllocatorKind::BUDDY) {
+        // 伙伴索引以位图为准建立，先让无锁模式下过期的组索引恢复准确
+        set_concurrent_mode(false);
+        buddy_ = std::make_unique<BuddyIndex>();
+        rebuild_buddy_index();
+    } else {
+        buddy_.reset();
     }
 }
 
@@ -135,15 +815,17 @@ void FreeBitmap::print_status() const {
     {
         // ReadWriteLock::ReadGuard guard(rw_lock_);
         total = total_blocks_;
-        free = free_blocks_;
-        sample_size = std::min<size_t>(8, bitmap_.size());
-        sample.assign(bitmap_.begin(), bitmap_.begin() + sample_size);
+        free = free_count();
+        sample_size = std::min<size_t>(8, bitmap_bytes());
+        const auto* bytes = reinterpret_cast<const uint8_t*>(raw_words());
+        sample.assign(bytes, bytes + sample_size);
     }
 
     std::cout << "\n=== 空闲盘块表状态 ===" << std::endl;
     std::cout << "总块数: " << total << std::endl;
     std::cout << "空闲块数: " << free << std::endl;
     std::cout << "已使用块数: " << (total - free) << std::endl;
+    std::cout << "预留块数: " << get_reserved_blocks() << std::endl;
     if (total > 0) {
         std::cout << "使用率: " << std::fixed << std::setprecision(2)
                   << ((total - free) * 100.0 / total) << "%" << std::endl;
@@ -156,25 +838,93 @@ void FreeBitmap::print_status() const {
                   << static_cast<int>(sample[i]) << " ";
     }
     std::cout << std::dec << std::endl;
+    const auto dirty_groups = std::count_if(groups_.begin(), groups_.end(),
+                                            [](const auto& group) { return group->dirty.load(); });
+    std::cout << "位图块数: " << bitmap_blocks_ << std::endl;
+    std::cout << "分配组: " << groups_.size() << " 个（每组 " << BITMAP_GROUP_BLOCKS
+              << " 块，待写回 " << dirty_groups << " 组）" << std::endl;
+    std::cout << "位图扫描内核: " << bitmap_kernels().name << std::endl;
+    if (buddy_) {
+        std::cout << "分配模式: 伙伴系统" << std::endl;
+        LockGuard<SimpleMutex> buddy_lock(buddy_lock_);
+        const std::vector<size_t> orders = buddy_->order_counts();
+        std::cout << "各阶空闲块数: ";
+        for (size_t order = 0; order < orders.size(); ++order) {
+            if (orders[order] > 0) {
+                std::cout << (1u << order) << "块×" << orders[order] << " ";
+            }
+        }
+        std::cout << std::endl;
+    } else {
+        std::cout << "分配模式: " << (is_concurrent_mode() ? "无锁并发" : "分组加锁") << std::endl;
+    }
+
+    // 按区域输出空闲块分布
+    const std::vector<uint32_t> regions = get_region_free_counts(BITMAP_REGION_BLOCKS);
+    std::cout << "各区域空闲块数（每区域 " << BITMAP_REGION_BLOCKS << " 块）: ";
+    for (const uint32_t free_count : regions) {
+        std::cout << free_count << " ";
+    }
+    std::cout << std::endl;
 }
 
 bool FreeBitmap::validate() const
 {
-    // ReadWriteLock::WriteGuard guard(rw_lock_);
-
-    // 重新计算空闲块数，验证内部状态是否一致
-    uint32_t calculated_free_blocks = 0;
-    for (uint32_t block = 0; block < total_blocks_; ++block) {
-        if (is_block_free(block)) {
-            calculated_free_blocks++;
-        }
+    // 伙伴锁先于组锁获取，再按组号顺序锁住所有组
+    LockGuard<SimpleMutex> buddy_lock(buddy_lock_);
+    std::vector<UniqueLock<SimpleMutex>> locks;
+    locks.reserve(groups_.size());
+    for (const auto& group : groups_) {
+        locks.emplace_back(group->lock);
+        refresh_group_locked(*group);
     }
 
-    const bool is_valid = (calculated_free_blocks == free_blocks_);
+    // 重新计算空闲块数，验证内部状态是否一致（并发模式下要求此时没有无锁分配在进行）
+    const uint32_t calculated_free_blocks = count_free_blocks();
+    const uint32_t recorded_free_blocks = free_count();
+
+    bool is_valid = (calculated_free_blocks == recorded_free_blocks);
 
     if (!is_valid) {
         std::cerr << "位图验证失败: 计算的空闲块数(" << calculated_free_blocks
-            << ") != 记录的空闲块数(" << free_blocks_ << ")" << std::endl;
+            << ") != 记录的空闲块数(" << recorded_free_blocks << ")" << std::endl;
+    }
+
+    // 每个组的区段索引必须恰好覆盖组内的空闲块
+    uint64_t group_free_total = 0;
+    for (size_t g = 0; g < groups_.size(); ++g) {
+        const AllocationGroup& group = *groups_[g];
+        uint64_t indexed_blocks = 0;
+        for (const auto& [start, length] : group.index.extents()) {
+            indexed_blocks += length;
+            if (start < group.start_block || start + length > group.end_block) {
+                std::cerr << "位图验证失败: 区段 [" << start << ", " << start + length
+                    << ") 越出分配组 " << g << std::endl;
+                return false;
+            }
+            for (uint32_t block = start; block < start + length; ++block) {
+                if (!is_block_free(block)) {
+                    std::cerr << "位图验证失败: 区段索引中的块 " << block << " 已被分配" << std::endl;
+                    return false;
+                }
+            }
+        }
+        if (indexed_blocks != group.free_blocks) {
+            std::cerr << "位图验证失败: 分配组 " << g << " 区段索引覆盖的块数(" << indexed_blocks
+                << ") != 组空闲块数(" << group.free_blocks << ")" << std::endl;
+            is_valid = false;
+        }
+        group_free_total += group.free_blocks;
+    }
+    if (group_free_total != recorded_free_blocks) {
+        std::cerr << "位图验证失败: 各组空闲块数之和(" << group_free_total
+            << ") != 记录的空闲块数(" << recorded_free_blocks << ")" << std::endl;
+        is_valid = false;
+    }
+    if (buddy_ && buddy_->free_blocks() != recorded_free_blocks) {
+        std::cerr << "位图验证失败: 伙伴索引空闲块数(" << buddy_->free_blocks()
+            << ") != 记录的空闲块数(" << recorded_free_blocks << ")" << std::endl;
+        is_valid = false;
     }
 
     return is_valid;
@@ -185,47 +935,51 @@ bool FreeBitmap::serialize_to(void* buffer, const size_t buffer_size) const {
     if (buffer == nullptr || buffer_size == 0) {
         return false;  // 无效的缓冲区
     }
-    const size_t required_size = bitmap_.size();
+    const size_t required_size = bitmap_bytes();
     if (buffer_size < required_size) {
         return false; // 缓冲区大小不足
     }
-    memcpy(buffer, bitmap_.data(), required_size);
+    memcpy(buffer, raw_words(), required_size);
     return true;
 }
 
 bool FreeBitmap::deserialize_from(const void* buffer, const size_t buffer_size) {
     // ReadWriteLock::WriteGuard guard(rw_lock_);
 
-    const size_t required_size = bitmap_.size();
+    const size_t required_size = bitmap_bytes();
     if (buffer_size < required_size) {
         return false;
     }
-    memcpy(bitmap_.data(), buffer, required_size);
-
-    // 重新计算空闲块数
-    free_blocks_ = 0;
-    for (uint32_t block = 0; block < total_blocks_; ++block) {
-        if (is_block_free(block)) {
-            free_blocks_++;
-        }
+    memcpy(reinterpret_cast<uint8_t*>(bitmap_.data()), buffer, required_size);
+    mark_tail_padding();
+    reserve_metadata_blocks();
+    for (const auto& group : groups_) {
+        group->dirty = true;
     }
+
+    // 重新计算空闲块数与各组索引
+    rebuild_extent_index();
     return true;
 }
 
 void FreeBitmap::mark_block_used(const uint32_t block_id) {
-    // ReadWriteLock::WriteGuard guard(rw_lock_);
     if (block_id >= total_blocks_) return;
-    set_block_status(block_id, true);
+    LockGuard<SimpleMutex> buddy_lock(buddy_lock_);
+    AllocationGroup& group = group_of(block_id);
+    LockGuard<SimpleMutex> lock(group.lock);
+    if (set_block_status(block_id, true) && buddy_) {
+        buddy_->remove(block_id, 1);
+    }
 }
 
 
 // [修正] 实现与头文件一致的 `initialize`
-bool FreeBitmap::initialize(CacheManager* cache, const uint32_t total_blocks) {
+bool FreeBitmap::initialize(CacheManager* cache, const uint32_t total_blocks, const uint32_t reserved_blocks,
+                            const uint32_t bitmap_start) {
     // ReadWriteLock::WriteGuard guard(rw_lock_);
     cache_ = cache;
-    total_blocks_ = total_blocks;
-    if (total_blocks_ == 0) return false;
-    bitmap_.resize((total_blocks_ + 7) / 8, 0);
+    if (total_blocks == 0) return false;
+    setup_layout(total_blocks, reserved_blocks, bitmap_start);
 
     initialize(); // 调用内部初始化逻辑
 
@@ -233,30 +987,30 @@ bool FreeBitmap::initialize(CacheManager* cache, const uint32_t total_blocks) {
 }
 
 // [修正] 实现与头文件一致的 `load`
-bool FreeBitmap::load(CacheManager* cache, const uint32_t total_blocks) {
+bool FreeBitmap::load(CacheManager* cache, const uint32_t total_blocks, const uint32_t reserved_blocks,
+                      const uint32_t bitmap_start) {
     // ReadWriteLock::WriteGuard guard(rw_lock_);
     cache_ = cache;
-    total_blocks_ = total_blocks;
-    if (total_blocks_ == 0) return false;
+    if (total_blocks == 0) return false;
+    setup_layout(total_blocks, reserved_blocks, bitmap_start);
 
-    const size_t bitmap_size = (total_blocks_ + 7) / 8;
-    bitmap_.resize(bitmap_size);
-
-    if (!cache_->read_block(0, bitmap_.data())) {
-        return false;
-    }
-
-    // 重新计算空闲块数并标记保留块
-    free_blocks_ = 0;
-    for (uint32_t block = 0; block < total_blocks_; ++block) {
-        if (is_block_free(block)) {
-            free_blocks_++;
+    // 位图块在磁盘上连续存放，先整段预取再逐块拷贝
+    cache_->prefetch(bitmap_start_, bitmap_blocks_, CacheClass::METADATA);
+    auto* bytes = reinterpret_cast<uint8_t*>(bitmap_.data());
+    const size_t total_bytes = bitmap_.size() * sizeof(uint64_t);
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    for (uint32_t i = 0; i < bitmap_blocks_; ++i) {
+        if (!cache_->read_block(bitmap_start_ + i, block_buffer.data(), CacheClass::METADATA)) {
+            return false;
         }
+        const size_t offset = static_cast<size_t>(i) * BLOCK_SIZE;
+        memcpy(bytes + offset, block_buffer.data(), std::min<size_t>(BLOCK_SIZE, total_bytes - offset));
     }
-    if (total_blocks_ > 1) {
-        set_block_status(0, true);
-        set_block_status(1, true);
-    }
+    mark_tail_padding();
+
+    // 标记保留块，再重新计算空闲块数与各组索引
+    reserve_metadata_blocks();
+    rebuild_extent_index();
     return true;
 }
 
@@ -264,5 +1018,40 @@ bool FreeBitmap::load(CacheManager* cache, const uint32_t total_blocks) {
 bool FreeBitmap::save() const {
     // ReadWriteLock::ReadGuard guard(rw_lock_);
     if (!cache_) return false;
-    return cache_->write_block(0, bitmap_.data());
-}
\ No newline at end of file
+
+    // 只写回自上次保存以来有组发生变化的位图块；每组的位图切片在持有组锁时拷贝
+    constexpr uint32_t groups_per_block = BITMAP_BLOCK_BITS / BITMAP_GROUP_BLOCKS;
+    const auto* bytes = reinterpret_cast<const uint8_t*>(raw_words());
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    bool ok = true;
+    for (uint32_t i = 0; i < bitmap_blocks_; ++i) {
+        const size_t first_group = static_cast<size_t>(i) * groups_per_block;
+        const size_t last_group = std::min(first_group + groups_per_block, groups_.size());
+        std::vector<size_t> dirty_groups;
+        std::fill(block_buffer.begin(), block_buffer.end(), 0);
+        for (size_t g = first_group; g < last_group; ++g) {
+            AllocationGroup& group = *groups_[g];
+            LockGuard<SimpleMutex> lock(group.lock);
+            // 先清脏标记再拷贝：拷贝之后发生的无锁修改会重新置脏，不会丢失
+            if (group.dirty.exchange(false, std::memory_order_acq_rel)) {
+                dirty_groups.push_back(g);
+            }
+            const size_t first_word = group.start_block / WORD_BITS;
+            const size_t end_word = (group.end_block + WORD_BITS - 1) / WORD_BITS;
+            memcpy(block_buffer.data() + (first_word * sizeof(uint64_t) - static_cast<size_t>(i) * BLOCK_SIZE),
+                   bytes + first_word * sizeof(uint64_t), (end_word - first_word) * sizeof(uint64_t));
+        }
+        if (dirty_groups.empty()) {
+            continue;
+        }
+        if (!cache_->write_block(bitmap_start_ + i, block_buffer.data(), CacheClass::METADATA)) {
+            // 写入失败，恢复脏标记以便下次重试
+            for (const size_t g : dirty_groups) {
+                LockGuard<SimpleMutex> lock(groups_[g]->lock);
+                groups_[g]->dirty = true;
+            }
+            ok = false;
+        }
+    }
+    return ok;
+}
@@ -2,23 +2,91 @@
 #define BITMAP_H
 
 #include <vector>
+#include <memory>
+#include <atomic>
 
 #include "cache.h"
+#include "extent_index.h"
+#include "buddy.h"
 #include "disk.h"
 #include "directory.h"
 #include "../process/sync.h"
 
+#define BITMAP_REGION_BLOCKS 8192   // 区域空闲统计的粒度（块）
+#define BITMAP_BLOCK_BITS (BLOCK_SIZE * 8) // 每个位图块描述的块数
+#define BITMAP_GROUP_BLOCKS 8192    // 每个分配组的块数（须整除 BITMAP_BLOCK_BITS）
+#define BITMAP_GOAL_PROBES 32       // 按目标块分配时向后检查的区段数上限
+#define BITMAP_LOCKFREE_MAX_RUN 32  // 并发模式下走无锁路径的最大连续块数（须在单个字内）
+#define BITMAP_FRAG_BUCKETS 16      // 空闲区段长度直方图的桶数（按2的幂分桶）
+
+static_assert(BITMAP_BLOCK_BITS % BITMAP_GROUP_BLOCKS == 0 && BITMAP_GROUP_BLOCKS % 64 == 0,
+              "分配组必须按字对齐且不跨越位图块");
+
+// 连续块分配引擎（挂载时选择，磁盘格式相同）
+enum class AllocatorKind : uint8_t {
+    BITMAP,     // 分组位图 + 空闲区段索引
+    BUDDY       // 伙伴系统
+};
+
+/**
+ * 空闲空间碎片统计
+ * 直方图第i桶为长度在 [2^i, 2^(i+1)) 的空闲区段数，最后一桶包含所有更长的区段
+ */
+struct FragmentationStats {
+    uint32_t free_blocks = 0;       // 空闲块总数
+    uint32_t free_extents = 0;      // 空闲区段数
+    uint32_t largest_extent = 0;    // 最大空闲区段长度
+    std::vector<uint32_t> histogram; // 区段长度直方图
+
+    // 碎片化程度：0表示空闲空间完全连续，越接近100表示越分散
+    double score() const {
+        return free_blocks == 0 ? 0.0 : 100.0 * (1.0 - static_cast<double>(largest_extent) / free_blocks);
+    }
+};
+
+/**
+ * 分配组
+ * 块空间按 BITMAP_GROUP_BLOCKS 切分，每组有独立的锁、空闲计数、区段索引与扫描游标，
+ * 组内的空闲计数与区段索引只在持有该组锁时修改；
+ * 并发模式下位图字还会被无锁路径直接CAS修改，此时索引只作提示，标记为过期后在加锁路径上重建
+ */
+struct AllocationGroup {
+    uint32_t start_block = 0;       // 组内第一个块
+    uint32_t end_block = 0;         // 组尾（不含）
+    uint32_t free_blocks = 0;       // 组内空闲块数（索引过期时同样过期）
+    std::atomic<uint32_t> rotor{0}; // 下次扫描的起点（上次分配结束的位置）
+    std::atomic<bool> dirty{false}; // 本组的位图切片是否需要写回
+    std::atomic<bool> stale{false}; // 无锁路径修改过位图，索引与空闲计数需要重建
+    FreeExtentIndex index;          // 组内空闲区段
+    mutable SimpleMutex lock;       // 组锁
+};
+
 /**
  * 空闲盘块表 - 使用位图管理磁盘空间
  * 支持单块和连续块的分配，采用位图方式管理空闲状态
+ * 位图按64位字存储，块 n 对应第 n/64 个字的第 n%64 位；
+ * 小端序下与按字节存储的磁盘格式完全一致，末尾多出的填充位恒为1（视为已分配）
+ * 位图从 bitmap_start 开始占用 ceil(总块数 / BITMAP_BLOCK_BITS) 个块（之前为超级块），紧随其后是保留给inode位图与inode表的块，
+ * 每个分配组单独记录脏标记，save 只写回发生变化的位图块
+ * 分配时线程优先使用按首次分配顺序编号得到的组，满了再尝试其他组，超过一组大小的请求才锁住所有组
+ * 并发模式下，单块与不超过 BITMAP_LOCKFREE_MAX_RUN 的小段分配/释放直接对位图字做CAS，不取任何锁
+ * 伙伴模式下由内存中的伙伴索引决定分配位置，所有分配与释放在伙伴锁下串行执行，位图仍是持久化的依据
  */
 class FreeBitmap
 {
-    std::vector<uint8_t> bitmap_; // 位图数组，每个bit表示一个块的状态
+    std::vector<std::atomic<uint64_t>> bitmap_; // 位图数组，每个bit表示一个块的状态
     uint32_t total_blocks_; // 总块数
-    uint32_t free_blocks_; // 空闲块数
+    StripedCounter free_blocks_; // 空闲块数（分条计数，并发时为近似值）
+    uint32_t bitmap_start_ = 0; // 位图起始块号（之前为超级块）
+    uint32_t bitmap_blocks_; // 位图自身占用的块数
+    uint32_t first_data_block_; // 第一个数据块（之前为位图与Inode表）
     mutable ReadWriteLock rw_lock_;  // 使用读写锁优化并发性能
     CacheManager* cache_; // **[修改]** 添加cache管理器指针
+    std::vector<std::unique_ptr<AllocationGroup>> groups_; // 分配组
+    std::atomic<bool> concurrent_{false}; // 是否启用无锁并发模式
+    std::atomic<uint32_t> reserved_blocks_{0}; // 已预留但尚未分配的块数（延迟分配）
+    std::unique_ptr<BuddyIndex> buddy_; // 伙伴索引，非空表示处于伙伴模式
+    mutable SimpleMutex buddy_lock_; // 保护伙伴索引，伙伴模式下先于组锁获取
 
     /**
      * 检查指定块是否空闲
@@ -28,17 +96,19 @@ class FreeBitmap
     bool is_block_free(uint32_t block_no) const;
 
     /**
-     * 设置块的状态
+     * 设置块的状态（需持有块所在组的锁）
      * @param block_no 块号
      * @param allocated true表示分配，false表示释放
+     * @return true如果状态发生了变化
      */
-    void set_block_status(uint32_t block_no, bool allocated);
+    bool set_block_status(uint32_t block_no, bool allocated);
 
     /**
-     * 查找第一个空闲块
+     * 从组的游标处开始查找组内第一个空闲块（需持有组锁）
+     * @param group 分配组
      * @return 空闲块号，如果没有返回UINT32_MAX
      */
-    uint32_t find_first_free_block() const;
+    uint32_t find_free_in_group_locked(const AllocationGroup& group) const;
 
     /**
      * 查找指定数量的连续空闲块
@@ -47,6 +117,142 @@ class FreeBitmap
      */
     uint32_t find_consecutive_free_blocks(uint32_t count) const;
 
+    /**
+     * 按总块数计算布局并分配内存位图
+     * @param total_blocks 总块数
+     * @param reserved_blocks 位图之后保留的块数（inode位图与inode表）
+     * @param bitmap_start 位图起始块号
+     */
+    void setup_layout(uint32_t total_blocks, uint32_t reserved_blocks, uint32_t bitmap_start);
+
+    /**
+     * 把位图块与保留块标记为已分配
+     */
+    void reserve_metadata_blocks();
+
+    /**
+     * 块所在的分配组
+     */
+    AllocationGroup& group_of(uint32_t block_no) const;
+
+    /**
+     * 当前线程优先使用的分配组
+     */
+    size_t preferred_group() const;
+
+    /**
+     * 用CAS把 [start, start+count) 的位全部置1，遇到已被占用的位时撤销并返回false
+     */
+    bool set_range_bits(uint32_t start, uint32_t count);
+
+    /**
+     * 原子地清除 [start, end) 的位
+     * @param index 非空时把实际被释放的游程加入该索引
+     * @return 实际由已分配变为空闲的块数
+     */
+    uint32_t clear_range_bits(uint32_t start, uint32_t end, FreeExtentIndex* index);
+
+    /**
+     * 把组内一段空闲块标记为已分配（需持有组锁）
+     * @return false表示与无锁分配冲突，组索引已标记为过期
+     */
+    bool claim_range_locked(AllocationGroup& group, uint32_t start, uint32_t count);
+
+    /**
+     * 释放组内 [start, end) 中已分配的块（需持有组锁）
+     */
+    void release_range_locked(AllocationGroup& group, uint32_t start, uint32_t end);
+
+    /**
+     * 无锁释放组内 [start, end) 的块，组索引标记为过期
+     */
+    void release_range_lockfree(AllocationGroup& group, uint32_t start, uint32_t end);
+
+    /**
+     * 无锁分配：在单个字内查找count个连续空闲位并CAS置位
+     * @return true如果分配成功
+     */
+    bool try_allocate_lockfree(uint32_t count, uint32_t goal, uint32_t& start_block);
+
+    /**
+     * 锁住所有组后在整张位图上查找并分配连续块（用于跨组的大请求）
+     */
+    bool allocate_across_groups(uint32_t count, uint32_t& start_block);
+
+    /**
+     * 按字扫描位图，重建所有组的空闲区段索引与空闲块数（初始化与装入后调用）
+     */
+    void rebuild_extent_index();
+
+    /**
+     * 由各组的空闲区段重建伙伴索引（需保证没有并发分配）
+     */
+    void rebuild_buddy_index();
+
+    /**
+     * 伙伴模式下的连续块分配：按伙伴索引选址，没有足够大的对齐块时退回位图扫描
+     */
+    bool allocate_buddy(uint32_t count, uint32_t& start_block, uint32_t goal);
+
+    /**
+     * 伙伴模式下的释放：清除位图后把实际释放的游程归还伙伴索引
+     */
+    void free_buddy(uint32_t start_block, uint32_t end_block);
+
+    /**
+     * 按字扫描组内位图，重建该组的区段索引与空闲块数（需持有组锁）
+     */
+    void rebuild_group_locked(AllocationGroup& group) const;
+
+    /**
+     * 组索引被无锁路径标记为过期时重建（需持有组锁）
+     */
+    void refresh_group_locked(AllocationGroup& group) const;
+
+    /**
+     * 按字统计空闲块数（popcount）
+     * @return 空闲块数
+     */
+    uint32_t count_free_blocks() const;
+
+    /**
+     * 读取第w个字，保留区内的块视为已分配
+     */
+    uint64_t load_word(size_t w) const;
+
+    /**
+     * 第w个字中属于保留区的位
+     */
+    uint64_t reserved_mask(size_t w) const;
+
+    /**
+     * 以普通整数数组的形式访问位图（供扫描内核与序列化使用）
+     */
+    const uint64_t* raw_words() const;
+
+    /**
+     * 当前空闲块数
+     */
+    uint32_t free_count() const;
+
+    /**
+     * 扣除预留后可供普通分配使用的块数
+     */
+    uint32_t available_count() const;
+
+    /**
+     * 把最后一个字中超出总块数的填充位置1，保证按字扫描不会越界分配
+     */
+    void mark_tail_padding();
+
+    /**
+     * 位图序列化后的字节数
+     */
+    size_t bitmap_bytes() const
+    {
+        return (static_cast<size_t>(total_blocks_) + 7) / 8;
+    }
+
 public:
 
     FreeBitmap(const FreeBitmap&) = delete;
@@ -79,11 +285,14 @@ public:
 
     /**
      * 分配指定数量的连续空闲块
+     * 给出目标块时优先在目标块所在的组内、从目标块向后就近分配，使相关数据聚集；
+     * 附近放不下时退回最佳适配
      * @param count 需要分配的连续块数
      * @param start_block 输出参数，返回起始块号
+     * @param goal 目标块号（如父目录或前一段数据之后），UINT32_MAX表示无偏好
      * @return true如果分配成功，false如果没有足够的连续空闲块
      */
-    bool allocate_consecutive_blocks(uint32_t count, uint32_t& start_block);
+    bool allocate_consecutive_blocks(uint32_t count, uint32_t& start_block, uint32_t goal = UINT32_MAX);
 
     /**
      * 释放一个块
@@ -107,14 +316,69 @@ public:
         return total_blocks_;
     }
 
+    /**
+     * 获取位图起始块号
+     * @return 位图起始块号
+     */
+    uint32_t get_bitmap_start() const
+    {
+        return bitmap_start_;
+    }
+
+    /**
+     * 获取位图自身占用的块数（Inode表紧随其后）
+     * @return 位图块数
+     */
+    uint32_t get_bitmap_blocks() const
+    {
+        return bitmap_blocks_;
+    }
+
+    /**
+     * 获取第一个可分配的数据块号
+     * @return 数据区起始块号
+     */
+    uint32_t get_first_data_block() const
+    {
+        return first_data_block_;
+    }
+
+    /**
+     * 计算描述指定块数所需的位图块数
+     * @param total_blocks 总块数
+     * @return 位图块数
+     */
+    static uint32_t bitmap_blocks_for(uint32_t total_blocks);
+
     /**
      * 获取空闲块数
      * @return 空闲块数
      */
     uint32_t get_free_blocks() const
     {
-        ReadWriteLock::ReadGuard guard(rw_lock_);
-        return free_blocks_;
+        return free_count();
+    }
+
+    /**
+     * 预留块：只占用额度不选择位置，供延迟分配在写回时再实际分配
+     * @param count 预留块数
+     * @return true如果扣除已有预留后仍有足够的空闲块
+     */
+    bool reserve_blocks(uint32_t count);
+
+    /**
+     * 归还预留额度（写回前或丢弃缓冲数据时调用）
+     * @param count 归还的块数
+     */
+    void release_reservation(uint32_t count);
+
+    /**
+     * 获取当前预留的块数
+     * @return 预留块数
+     */
+    uint32_t get_reserved_blocks() const
+    {
+        return reserved_blocks_.load(std::memory_order_relaxed);
     }
 
     /**
@@ -123,8 +387,7 @@ public:
      */
     uint32_t get_used_blocks() const
     {
-        ReadWriteLock::ReadGuard guard(rw_lock_);
-        return total_blocks_ - free_blocks_;
+        return total_blocks_ - free_count();
     }
 
     /**
@@ -133,12 +396,41 @@ public:
      */
     double get_usage_ratio() const
     {
-        ReadWriteLock::ReadGuard guard(rw_lock_);
         if (total_blocks_ == 0) {
             return 0.0; // 避免除以零
         }
 
-        return static_cast<double>(total_blocks_ - free_blocks_) / total_blocks_;
+        return static_cast<double>(total_blocks_ - free_count()) / total_blocks_;
+    }
+
+    /**
+     * 开启或关闭无锁并发模式
+     * 开启后单块与小段分配/释放不再取组锁，组索引改为按需重建
+     * @param enabled true表示开启
+     */
+    void set_concurrent_mode(bool enabled);
+
+    /**
+     * 是否处于无锁并发模式
+     */
+    bool is_concurrent_mode() const
+    {
+        return concurrent_.load(std::memory_order_relaxed);
+    }
+
+    /**
+     * 选择连续块分配引擎（挂载后、开始分配前调用）
+     * 切换到伙伴模式时由当前位图建立伙伴索引，并关闭无锁并发模式
+     * @param kind 分配引擎
+     */
+    void set_allocator(AllocatorKind kind);
+
+    /**
+     * 当前的分配引擎
+     */
+    AllocatorKind get_allocator() const
+    {
+        return buddy_ ? AllocatorKind::BUDDY : AllocatorKind::BITMAP;
     }
 
     /**
@@ -158,6 +450,19 @@ public:
      * @return true如果数据一致，false如果有错误
      */
     bool validate() const;
+
+    /**
+     * 统计每个区域的空闲块数
+     * @param region_blocks 区域大小（块数，按64对齐）
+     * @return 各区域的空闲块数
+     */
+    std::vector<uint32_t> get_region_free_counts(uint32_t region_blocks) const;
+
+    /**
+     * 统计空闲空间碎片情况（直接扫描位图，跨组相邻的空闲块视为同一区段）
+     * @return 碎片统计
+     */
+    FragmentationStats get_fragmentation() const;
     bool serialize_to(void* buffer, size_t buffer_size) const;
     bool deserialize_from(const void* buffer, size_t buffer_size);
 
@@ -175,8 +480,9 @@ public:
 
     void mark_block_used(uint32_t block_id);
     // **[修改]** 更新接口以使用CacheManager
-    bool initialize(CacheManager* cache, uint32_t total_blocks);
-    bool load(CacheManager* cache, const uint32_t total_blocks);
+    // reserved_blocks 为位图之后保留的块数（inode位图与inode表），bitmap_start 为位图之前的块数（超级块）
+    bool initialize(CacheManager* cache, uint32_t total_blocks, uint32_t reserved_blocks = 1, uint32_t bitmap_start = 0);
+    bool load(CacheManager* cache, uint32_t total_blocks, uint32_t reserved_blocks = 1, uint32_t bitmap_start = 0);
     bool save() const;
 };
 
@@ -0,0 +1,143 @@
+#include "bitmap_simd.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#define BITMAP_SIMD_X86 1
+#endif
+
+namespace {
+    constexpr uint64_t FULL_WORD = ~0ULL;
+
+    // ---------- 标量实现 ----------
+    size_t find_not_full_scalar(const uint64_t* words, size_t begin, const size_t end) {
+        for (; begin < end; ++begin) {
+            if (words[begin] != FULL_WORD) {
+                return begin;
+            }
+        }
+        return end;
+    }
+
+    size_t find_not_empty_scalar(const uint64_t* words, size_t begin, const size_t end) {
+        for (; begin < end; ++begin) {
+            if (words[begin] != 0) {
+                return begin;
+            }
+        }
+        return end;
+    }
+
+    uint64_t count_ones_scalar(const uint64_t* words, const size_t begin, const size_t end) {
+        uint64_t total = 0;
+        for (size_t i = begin; i < end; ++i) {
+            total += __builtin_popcountll(words[i]);
+        }
+        return total;
+    }
+
+#ifdef BITMAP_SIMD_X86
+    // ---------- SSE2 实现：每次处理128位（2个字），i386 默认不启用SSE2，需单独指定目标 ----------
+    __attribute__((target("sse2")))
+    size_t find_not_full_sse2(const uint64_t* words, size_t begin, const size_t end) {
+        const __m128i ones = _mm_set1_epi32(-1);
+        for (; begin + 2 <= end; begin += 2) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + begin));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, ones)) != 0xFFFF) {
+                return words[begin] != FULL_WORD ? begin : begin + 1;
+            }
+        }
+        return find_not_full_scalar(words, begin, end);
+    }
+
+    __attribute__((target("sse2")))
+    size_t find_not_empty_sse2(const uint64_t* words, size_t begin, const size_t end) {
+        const __m128i zero = _mm_setzero_si128();
+        for (; begin + 2 <= end; begin += 2) {
+            const __m128i v = _mm_loadu_si128(reinterpret_cast<const __m128i*>(words + begin));
+            if (_mm_movemask_epi8(_mm_cmpeq_epi8(v, zero)) != 0xFFFF) {
+                return words[begin] != 0 ? begin : begin + 1;
+            }
+        }
+        return find_not_empty_scalar(words, begin, end);
+    }
+
+    // ---------- AVX2 实现：每次处理256位（4个字） ----------
+    __attribute__((target("avx2")))
+    size_t find_not_full_avx2(const uint64_t* words, size_t begin, const size_t end) {
+        const __m256i ones = _mm256_set1_epi64x(-1);
+        for (; begin + 4 <= end; begin += 4) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + begin));
+            if (!_mm256_testc_si256(v, ones)) {
+                break; // 本组4个字中存在空闲位
+            }
+        }
+        return find_not_full_scalar(words, begin, end);
+    }
+
+    __attribute__((target("avx2")))
+    size_t find_not_empty_avx2(const uint64_t* words, size_t begin, const size_t end) {
+        for (; begin + 4 <= end; begin += 4) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + begin));
+            if (!_mm256_testz_si256(v, v)) {
+                break;
+            }
+        }
+        return find_not_empty_scalar(words, begin, end);
+    }
+
+    // 半字节查表法：每字节的1的个数由两次 pshufb 得到，再用 sad 按64位累加
+    __attribute__((target("avx2")))
+    uint64_t count_ones_avx2(const uint64_t* words, const size_t begin, const size_t end) {
+        const __m256i lut = _mm256_setr_epi8(0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4,
+                                             0, 1, 1, 2, 1, 2, 2, 3, 1, 2, 2, 3, 2, 3, 3, 4);
+        const __m256i low_mask = _mm256_set1_epi8(0x0f);
+        const __m256i zero = _mm256_setzero_si256();
+        __m256i acc = zero;
+
+        size_t i = begin;
+        for (; i + 4 <= end; i += 4) {
+            const __m256i v = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(words + i));
+            const __m256i lo = _mm256_and_si256(v, low_mask);
+            const __m256i hi = _mm256_and_si256(_mm256_srli_epi16(v, 4), low_mask);
+            const __m256i counts = _mm256_add_epi8(_mm256_shuffle_epi8(lut, lo), _mm256_shuffle_epi8(lut, hi));
+            acc = _mm256_add_epi64(acc, _mm256_sad_epu8(counts, zero));
+        }
+
+        alignas(32) uint64_t lanes[4];
+        _mm256_store_si256(reinterpret_cast<__m256i*>(lanes), acc);
+        return lanes[0] + lanes[1] + lanes[2] + lanes[3] + count_ones_scalar(words, i, end);
+    }
+#endif
+
+    const BitmapKernels SCALAR_KERNELS = {
+        "scalar", find_not_full_scalar, find_not_empty_scalar, count_ones_scalar
+    };
+
+#ifdef BITMAP_SIMD_X86
+    const BitmapKernels SSE2_KERNELS = {
+        "sse2", find_not_full_sse2, find_not_empty_sse2, count_ones_scalar
+    };
+
+    const BitmapKernels AVX2_KERNELS = {
+        "avx2", find_not_full_avx2, find_not_empty_avx2, count_ones_avx2
+    };
+#endif
+
+    const BitmapKernels& select_kernels() {
+#ifdef BITMAP_SIMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2")) {
+            return AVX2_KERNELS;
+        }
+        if (__builtin_cpu_supports("sse2")) {
+            return SSE2_KERNELS;
+        }
+#endif
+        return SCALAR_KERNELS;
+    }
+}
+
+const BitmapKernels& bitmap_kernels() {
+    static const BitmapKernels& kernels = select_kernels();
+    return kernels;
+}
@@ -0,0 +1,30 @@
+#ifndef BITMAP_SIMD_H
+#define BITMAP_SIMD_H
+
+#include <cstddef>
+#include <cstdint>
+
+/**
+ * 位图扫描内核
+ * 在 [begin, end) 字区间上工作，启动时按 CPUID 选择 AVX2 / SSE2 / 标量实现，
+ * 位图中1表示已分配，0表示空闲
+ */
+struct BitmapKernels {
+    const char* name;   // 内核名称（用于状态输出）
+
+    // 返回第一个不是全1（含空闲块）的字下标，不存在时返回 end
+    size_t (*find_not_full)(const uint64_t* words, size_t begin, size_t end);
+
+    // 返回第一个不是全0（含已分配块）的字下标，不存在时返回 end
+    size_t (*find_not_empty)(const uint64_t* words, size_t begin, size_t end);
+
+    // 统计区间内1的个数（已分配块数）
+    uint64_t (*count_ones)(const uint64_t* words, size_t begin, size_t end);
+};
+
+/**
+ * 获取当前CPU可用的最佳内核（首次调用时检测，之后直接返回）
+ */
+const BitmapKernels& bitmap_kernels();
+
+#endif //BITMAP_SIMD_H
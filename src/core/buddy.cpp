@@ -0,0 +1,102 @@
+#include "buddy.h"
+#include <algorithm>
+
+uint32_t BuddyIndex::order_for(const uint32_t count) {
+    return count <= 1 ? 0 : 32 - __builtin_clz(count - 1);
+}
+
+void BuddyIndex::reset(const uint32_t total_blocks) {
+    max_order_ = total_blocks <= 1 ? 0 : order_for(total_blocks);
+    free_lists_.assign(max_order_ + 1, {});
+    free_blocks_ = 0;
+}
+
+void BuddyIndex::insert_chunk(uint32_t start, uint32_t order) {
+    free_blocks_ += 1u << order;
+
+    // 伙伴也空闲时摘下伙伴，合并成高一阶的块，直到伙伴不空闲或到达最大阶
+    while (order < max_order_) {
+        const uint32_t buddy = start ^ (1u << order);
+        auto& list = free_lists_[order];
+        const auto it = list.find(buddy);
+        if (it == list.end()) {
+            break;
+        }
+        list.erase(it);
+        start = std::min(start, buddy);
+        ++order;
+    }
+    free_lists_[order].insert(start);
+}
+
+void BuddyIndex::insert(uint32_t start, uint32_t length) {
+    // 每次取从start起对齐、且不超过剩余长度的最大块
+    while (length > 0) {
+        const uint32_t align_order = start == 0 ? max_order_ : __builtin_ctz(start);
+        const uint32_t fit_order = 31 - __builtin_clz(length);
+        const uint32_t order = std::min({align_order, fit_order, max_order_});
+        insert_chunk(start, order);
+        start += 1u << order;
+        length -= 1u << order;
+    }
+}
+
+void BuddyIndex::remove(const uint32_t start, const uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+    const uint64_t end = static_cast<uint64_t>(start) + length;
+
+    // 每一阶中与 [start, end) 重叠的块整块摘下，不重叠的部分稍后重新加入
+    std::vector<std::pair<uint32_t, uint32_t>> remainders;
+    for (uint32_t order = 0; order <= max_order_; ++order) {
+        auto& list = free_lists_[order];
+        const uint32_t size = 1u << order;
+        const uint32_t first = start & ~(size - 1);
+        for (auto it = list.lower_bound(first); it != list.end() && *it < end;) {
+            const uint32_t chunk = *it;
+            const uint64_t chunk_end = static_cast<uint64_t>(chunk) + size;
+            it = list.erase(it);
+            free_blocks_ -= size;
+            if (chunk < start) {
+                remainders.emplace_back(chunk, start - chunk);
+            }
+            if (chunk_end > end) {
+                remainders.emplace_back(static_cast<uint32_t>(end), static_cast<uint32_t>(chunk_end - end));
+            }
+        }
+    }
+
+    for (const auto& [piece_start, piece_length] : remainders) {
+        insert(piece_start, piece_length);
+    }
+}
+
+uint32_t BuddyIndex::find(const uint32_t count, const uint32_t goal) const {
+    if (count == 0) {
+        return UINT32_MAX;
+    }
+    for (uint32_t order = order_for(count); order <= max_order_; ++order) {
+        const auto& list = free_lists_[order];
+        if (list.empty()) {
+            continue;
+        }
+        if (goal != UINT32_MAX) {
+            const auto it = list.lower_bound(goal);
+            if (it != list.end()) {
+                return *it;
+            }
+        }
+        return *list.begin();
+    }
+    return UINT32_MAX;
+}
+
+std::vector<size_t> BuddyIndex::order_counts() const {
+    std::vector<size_t> counts;
+    counts.reserve(free_lists_.size());
+    for (const auto& list : free_lists_) {
+        counts.push_back(list.size());
+    }
+    return counts;
+}
@@ -0,0 +1,71 @@
+#ifndef BUDDY_H
+#define BUDDY_H
+
+#include <cstddef>
+#include <cstdint>
+#include <set>
+#include <vector>
+
+/**
+ * 伙伴系统空闲块索引
+ * 空闲空间按2的幂切成对齐的块，每个阶一个有序集合；
+ * 分配时取不小于所需阶的最小空闲块并逐级拆分，释放时与伙伴逐级合并，均为 O(log n)。
+ * 分配的块数不是2的幂时，多出的尾部立即按对齐块归还，不产生内部碎片
+ */
+class BuddyIndex
+{
+    std::vector<std::set<uint32_t>> free_lists_;    // 第i阶：长度为2^i的空闲块起始块号
+    uint32_t max_order_ = 0;                        // 最大阶
+    uint32_t free_blocks_ = 0;                      // 空闲块总数
+
+    void insert_chunk(uint32_t start, uint32_t order);
+
+public:
+    /**
+     * 清空索引并设置覆盖的块数
+     * @param total_blocks 总块数（决定最大阶）
+     */
+    void reset(uint32_t total_blocks);
+
+    /**
+     * 加入一段空闲块，拆成对齐块后与伙伴合并
+     * @param start 起始块号
+     * @param length 块数
+     */
+    void insert(uint32_t start, uint32_t length);
+
+    /**
+     * 从索引中扣除一段块（分配时调用），所在的对齐块被拆开，其余部分重新加入
+     * @param start 起始块号
+     * @param length 块数
+     */
+    void remove(uint32_t start, uint32_t length);
+
+    /**
+     * 查找能放下count块的空闲对齐块：取满足条件的最小阶，同阶中优先goal之后最近的一块
+     * @param count 需要的连续块数
+     * @param goal 目标块号，UINT32_MAX表示无偏好
+     * @return 起始块号，没有返回UINT32_MAX
+     */
+    uint32_t find(uint32_t count, uint32_t goal) const;
+
+    /**
+     * 空闲块总数
+     */
+    uint32_t free_blocks() const
+    {
+        return free_blocks_;
+    }
+
+    /**
+     * 各阶空闲块个数
+     */
+    std::vector<size_t> order_counts() const;
+
+    /**
+     * 能放下count块的最小阶
+     */
+    static uint32_t order_for(uint32_t count);
+};
+
+#endif //BUDDY_H
@@ -2,16 +2,18 @@
 #include "disk.h"
 #include <cstring>
 #include <algorithm>
+#include <fstream>
 #include <iomanip>
 #include <iostream>
 
-CacheManager::CacheManager(VirtualDisk* disk, const size_t page_count, const size_t block_size)
-    : disk_(disk), page_count_(page_count), block_size_(block_size) {
-    pages_.resize(page_count_);
+static_assert(sizeof(HotBlock) == 12, "热点块记录不能含隐式填充");
+
+CacheManager::CacheManager(VirtualDisk* disk, const size_t page_count, const size_t block_size,
+                           const double metadata_ratio)
+    : disk_(disk), pages_(page_count), page_count_(page_count), block_size_(block_size),
+      metadata_quota_(static_cast<size_t>(page_count * std::clamp(metadata_ratio, 0.0, 1.0))) {
+    // 页带有闩锁和条件变量，不可移动，因此直接按数量构造
     for (auto& page : pages_) {
-        page.block_no = UINT32_MAX;
-        page.dirty = false;
-        page.access_time = 0;
         page.data.resize(block_size_);
     }
 }
@@ -20,88 +22,139 @@ CacheManager::~CacheManager() {
     flush_all();
 }
 
-bool CacheManager::read_block(const uint32_t block_no, void* buffer) {
-    int page_index;
-
-    // 1. 加读锁，尝试在缓存中查找
-    {
-        // ReadWriteLock::ReadGuard lock(rw_lock_);
-        page_index = find_page(block_no);
-        if (page_index != -1) {
-            std::memcpy(buffer, pages_[page_index].data.data(), block_size_);
-            return true;
-        }
-    } // 读锁在这里释放
+bool CacheManager::read_block(const uint32_t block_no, void* buffer, const CacheClass cls) {
+    mrc_.record(block_no);
 
-    // 2. 缓存未命中，需要从磁盘加载，切换为写锁
-    // ReadWriteLock::WriteGuard lock(rw_lock_);
+    // 1. 查找并钉住页面，未命中时在不持有全局锁的情况下从磁盘加载
+    bool loading;
+    const int page_index = pin_page(block_no, true, cls, loading);
+    if (page_index == -1) {
+        return false; // 没有可用的缓存页或读取失败
+    }
 
-    // 3. 再次检查，防止在切换锁的间隙，其他线程已经加载了该页
-    page_index = find_page(block_no);
-    if (page_index != -1) {
+    // 2. 持页闩锁（共享）复制数据，其他页的访问不受影响
+    {
+        ReadWriteLock::ReadGuard latch(pages_[page_index].latch);
         std::memcpy(buffer, pages_[page_index].data.data(), block_size_);
-        return true;
     }
 
-    // 4. 确实不在缓存中，获取一个空闲页（或替换一个页）
-    page_index = get_free_page();
+    unpin_page(page_index, false, false);
+
+    // 3. 顺序访问区间内触发预读
+    readahead(block_no, cls);
+    return true;
+}
+
+PinnedPage CacheManager::pin_block(const uint32_t block_no, const CacheClass cls) {
+    mrc_.record(block_no);
+
+    PinnedPage pinned;
+    bool loading;
+    const int page_index = pin_page(block_no, true, cls, loading);
     if (page_index == -1) {
-        return false; // 没有可用的缓存页
+        return pinned;
     }
 
-    // 5. 从磁盘读取数据到缓存页
-    if (!disk_->read_block(block_no, pages_[page_index].data.data())) {
+    // 共享闩锁一直持有到解除钉住，期间写入该块的线程会等待
+    pages_[page_index].latch.read_lock();
+    pinned.cache_ = this;
+    pinned.page_index_ = page_index;
+    pinned.data_ = pages_[page_index].data.data();
+
+    readahead(block_no, cls);
+    return pinned;
+}
+
+void CacheManager::release_pinned(const int page_index) {
+    pages_[page_index].latch.read_unlock();
+    unpin_page(page_index, false, false);
+}
+
+PinnedPage::PinnedPage(PinnedPage&& other) noexcept
+    : cache_(other.cache_), page_index_(other.page_index_), data_(other.data_) {
+    other.cache_ = nullptr;
+    other.page_index_ = -1;
+    other.data_ = nullptr;
+}
+
+PinnedPage& PinnedPage::operator=(PinnedPage&& other) noexcept {
+    if (this != &other) {
+        release();
+        cache_ = other.cache_;
+        page_index_ = other.page_index_;
+        data_ = other.data_;
+        other.cache_ = nullptr;
+        other.page_index_ = -1;
+        other.data_ = nullptr;
+    }
+    return *this;
+}
+
+void PinnedPage::release() {
+    if (page_index_ != -1) {
+        cache_->release_pinned(page_index_);
+    }
+    cache_ = nullptr;
+    page_index_ = -1;
+    data_ = nullptr;
+}
+
+bool CacheManager::write_block(const uint32_t block_no, const void* buffer, const CacheClass cls) {
+    mrc_.record(block_no);
+
+    // 整块覆盖，旧内容会被完全替换，无需从磁盘读取；
+    // 未命中时页保持LOADING状态，直到新数据写入完毕
+    bool loading;
+    const int page_index = pin_page(block_no, false, cls, loading);
+    if (page_index == -1) {
         return false;
     }
 
-    // 6. 初始化新缓存页
-    pages_[page_index].block_no = block_no;
-    pages_[page_index].dirty = false;
-    pages_[page_index].access_time = time(nullptr);
-    block_to_page_[block_no] = page_index;
-    fifo_queue_.push(page_index);
+    // 更新页面数据并标记为脏页
+    {
+        ReadWriteLock::WriteGuard latch(pages_[page_index].latch);
+        std::memcpy(pages_[page_index].data.data(), buffer, block_size_);
+    }
 
-    // 7. 将数据复制到输出缓冲区
-    std::memcpy(buffer, pages_[page_index].data.data(), block_size_);
+    unpin_page(page_index, true, loading);
     return true;
 }
 
-bool CacheManager::write_block(const uint32_t block_no, const void* buffer) {
-    // ReadWriteLock::WriteGuard lock(rw_lock_);
+bool CacheManager::write_partial(const uint32_t block_no, const size_t offset, const void* buffer, const size_t size,
+                                 const CacheClass cls) {
+    if (offset > block_size_ || size > block_size_ - offset) {
+        return false;
+    }
 
-    int page_index = find_page(block_no);
+    mrc_.record(block_no);
 
-    // 如果页面不在缓存中
+    // 部分写未命中时需要先加载原始数据 (Fetch-on-write)
+    bool loading;
+    const int page_index = pin_page(block_no, true, cls, loading);
     if (page_index == -1) {
-        page_index = get_free_page();
-        if (page_index == -1) {
-            return false;
-        }
-
-        // **[修复]** 写未命中时，先从磁盘加载原始数据 (Fetch-on-write)
-        if (!disk_->read_block(block_no, pages_[page_index].data.data())) {
-             // 如果读取失败，可能是一个全新的块，可以忽略错误，或者进行错误处理
-        }
-
-        pages_[page_index].block_no = block_no;
-        pages_[page_index].access_time = time(nullptr);
-        block_to_page_[block_no] = page_index;
-        fifo_queue_.push(page_index);
+        return false;
     }
 
-    // 更新页面数据并标记为脏页
-    std::memcpy(pages_[page_index].data.data(), buffer, block_size_);
-    pages_[page_index].dirty = true;
+    {
+        ReadWriteLock::WriteGuard latch(pages_[page_index].latch);
+        std::memcpy(pages_[page_index].data.data() + offset, buffer, size);
+    }
 
+    unpin_page(page_index, true, false);
     return true;
 }
 
 void CacheManager::flush_all() {
-    // ReadWriteLock::WriteGuard lock(rw_lock_);
+    UniqueLock<SimpleMutex> lock(mutex_);
 
     for (size_t i = 0; i < pages_.size(); ++i) {
-        if (pages_[i].dirty) {
-            write_back_page(i);
+        CachePage& page = pages_[i];
+        // 其他线程正在装入或回写的页，等待其完成后再判断
+        page.state_cv.wait(lock, [&page] {
+            return page.state != PageState::LOADING && page.state != PageState::WRITEBACK;
+        });
+        if (page.state == PageState::VALID && page.dirty) {
+            write_back_page_locked(lock, i);
         }
     }
 }
@@ -111,54 +164,310 @@ int CacheManager::find_page(const uint32_t block_no) {
     return (it != block_to_page_.end()) ? it->second : -1;
 }
 
-int CacheManager::get_free_page() {
-    // 查找完全未使用的页面
-    for (size_t i = 0; i < pages_.size(); ++i) {
-        if (pages_[i].block_no == UINT32_MAX) {
-            return i;
+/**
+ * 查找块对应的缓存页并钉住（pin），未命中时分配页面并装入
+ * @param block_no 块号
+ * @param fetch 未命中时是否从磁盘读取原数据
+ * @param cls 页类别
+ * @param loading 输出参数，为true表示页处于LOADING状态，需由调用方写满数据后在unpin时完成装入
+ * @return 页索引，失败返回-1
+ */
+int CacheManager::pin_page(const uint32_t block_no, const bool fetch, const CacheClass cls, bool& loading) {
+    UniqueLock<SimpleMutex> lock(mutex_);
+    loading = false;
+    bool counted = false;
+
+    while (true) {
+        const int page_index = find_page(block_no);
+        if (page_index != -1) {
+            CachePage& page = pages_[page_index];
+            if (!counted) {
+                ++hits_;
+                counted = true;
+            }
+
+            // 页正在被其他线程装入时只在该页上等待
+            page.pin_count++;
+            page.state_cv.wait(lock, [&page] { return page.state != PageState::LOADING; });
+            if (page.block_no == block_no && page.state != PageState::FREE) {
+                touch_class(page_index, cls);
+                page.access_count++;
+                return page_index;
+            }
+
+            // 装入失败，页已被释放，重新查找
+            page.pin_count--;
+            unpin_cv_.notify_all();
+            continue;
+        }
+
+        if (!counted) {
+            ++misses_;
+            counted = true;
+        }
+
+        const int free_index = get_free_page_locked(lock, cls);
+        if (free_index == -1) {
+            return -1;
+        }
+        // 回写期间锁曾被释放，其他线程可能已装入该块
+        if (find_page(block_no) != -1) {
+            continue;
+        }
+
+        CachePage& page = pages_[free_index];
+        attach_page_locked(free_index, block_no, cls);
+        page.access_count = 1;
+
+        if (!fetch) {
+            loading = true;
+            return free_index;
+        }
+
+        // 磁盘读取期间不持有全局锁，LOADING状态阻止其他线程访问该页
+        lock.unlock();
+        const bool ok = disk_->read_block(block_no, page.data.data());
+        lock.lock();
+
+        if (!ok) {
+            block_to_page_.erase(block_no);
+            fifo_of(page.cls).erase(page.fifo_pos);
+            page.block_no = UINT32_MAX;
+            page.state = PageState::FREE;
+            page.pin_count--;
+            page.state_cv.notify_all();
+            unpin_cv_.notify_all();
+            return -1;
         }
+
+        ++disk_reads_;
+        page.state = PageState::VALID;
+        page.state_cv.notify_all();
+        return free_index;
+    }
+}
+
+// 把空闲页绑定到块上，进入LOADING状态并由调用方持有一个引用；
+// 位于NOREUSE区间的块插到FIFO队首，最先被置换
+void CacheManager::attach_page_locked(const int page_index, const uint32_t block_no, const CacheClass cls) {
+    CachePage& page = pages_[page_index];
+    page.block_no = block_no;
+    page.state = PageState::LOADING;
+    page.dirty = false;
+    page.cls = cls;
+    page.pin_count = 1;
+    page.access_count = 0;
+    page.access_time = time(nullptr);
+    block_to_page_[block_no] = page_index;
+    auto& fifo = fifo_of(cls);
+    const bool noreuse = (advice_flags_locked(block_no) & ADVICE_FLAG_NOREUSE) != 0;
+    page.fifo_pos = fifo.insert(noreuse ? fifo.begin() : fifo.end(), page_index);
+}
+
+// 释放对页的引用，dirtied表示数据已被修改，loaded表示调用方完成了LOADING页的整块写入
+void CacheManager::unpin_page(const uint32_t page_index, const bool dirtied, const bool loaded) {
+    LockGuard<SimpleMutex> lock(mutex_);
+    CachePage& page = pages_[page_index];
+    if (dirtied) {
+        page.dirty = true;
+    }
+    if (loaded) {
+        page.state = PageState::VALID;
+        page.state_cv.notify_all();
     }
+    if (--page.pin_count == 0) {
+        unpin_cv_.notify_all();
+    }
+}
+
+/**
+ * 把一段连续块中尚未缓存的部分批量装入缓存
+ * 连续的未命中块合并为一次磁盘读取，单批最多占用一半缓存页，避免钉住整个缓存
+ * @return 实际装入的块数
+ */
+size_t CacheManager::load_run(const uint32_t start_block, const uint32_t count, const CacheClass cls) {
+    const size_t batch_limit = std::max<size_t>(1, page_count_ / 2);
+    const uint32_t end_block = start_block + count;
+    size_t loaded = 0;
+
+    UniqueLock<SimpleMutex> lock(mutex_);
+    uint32_t block = start_block;
+    while (block < end_block) {
+        if (find_page(block) != -1) {
+            ++block;
+            continue;
+        }
+
+        // 收集一段连续的未缓存块，并为其占用LOADING页
+        const uint32_t run_start = block;
+        std::vector<int> run_pages;
+        while (block < end_block && run_pages.size() < batch_limit && find_page(block) == -1) {
+            const int free_index = get_free_page_locked(lock, cls);
+            if (free_index == -1 || find_page(block) != -1) {
+                break;
+            }
+            attach_page_locked(free_index, block, cls);
+            run_pages.push_back(free_index);
+            ++block;
+        }
+        if (run_pages.empty()) {
+            continue;
+        }
+
+        // 不持有全局锁进行一次合并读取
+        const auto run_length = static_cast<uint32_t>(run_pages.size());
+        lock.unlock();
+        std::vector<uint8_t> buffer(static_cast<size_t>(run_length) * block_size_);
+        const bool ok = disk_->read_blocks(run_start, run_length, buffer.data());
+        if (ok) {
+            for (uint32_t i = 0; i < run_length; ++i) {
+                std::memcpy(pages_[run_pages[i]].data.data(), buffer.data() + static_cast<size_t>(i) * block_size_, block_size_);
+            }
+        }
+        lock.lock();
+
+        for (const int index : run_pages) {
+            CachePage& page = pages_[index];
+            if (ok) {
+                page.state = PageState::VALID;
+            } else {
+                block_to_page_.erase(page.block_no);
+                fifo_of(page.cls).erase(page.fifo_pos);
+                page.block_no = UINT32_MAX;
+                page.state = PageState::FREE;
+            }
+            page.pin_count--;
+            page.state_cv.notify_all();
+        }
+        unpin_cv_.notify_all();
 
-    // 执行FIFO置换
-    if (!fifo_queue_.empty()) {
-        const int victim_index = fifo_queue_.front();
-        fifo_queue_.pop();
+        if (!ok) {
+            break;
+        }
+        disk_reads_ += run_length;
+        loaded += run_length;
+    }
+    return loaded;
+}
 
-        // 如果是脏页，先写回磁盘
-        if (pages_[victim_index].dirty) {
-            write_back_page(victim_index);
+// 在FIFO队列中找到第一个可置换（未被钉住且数据有效）的页
+int CacheManager::pick_victim_locked(const std::list<uint32_t>& fifo) const {
+    for (const uint32_t index : fifo) {
+        const CachePage& page = pages_[index];
+        if (page.pin_count == 0 && page.state == PageState::VALID) {
+            return static_cast<int>(index);
         }
+    }
+    return -1;
+}
+
+int CacheManager::get_free_page_locked(UniqueLock<SimpleMutex>& lock, const CacheClass incoming) {
+    if (pages_.empty()) {
+        return -1;
+    }
 
-        // 从映射中移除旧的块
-        block_to_page_.erase(pages_[victim_index].block_no);
+    while (true) {
+        // 查找完全未使用的页面
+        for (size_t i = 0; i < pages_.size(); ++i) {
+            if (pages_[i].state == PageState::FREE && pages_[i].pin_count == 0) {
+                return static_cast<int>(i);
+            }
+        }
+
+        // 选择置换队列：元数据在配额内时只置换数据页，
+        // 元数据超出配额（或新页本身是元数据且已达配额）时在元数据队列内部置换
+        std::list<uint32_t>* victim_fifo = &data_fifo_;
+        if (meta_fifo_.size() > metadata_quota_ ||
+            (incoming == CacheClass::METADATA && meta_fifo_.size() >= metadata_quota_) ||
+            data_fifo_.empty()) {
+            victim_fifo = &meta_fifo_;
+        }
+
+        int victim_index = pick_victim_locked(*victim_fifo);
+        if (victim_index == -1) {
+            victim_index = pick_victim_locked(victim_fifo == &meta_fifo_ ? data_fifo_ : meta_fifo_);
+        }
+        if (victim_index == -1) {
+            // 所有页都被钉住或正在进行I/O，等待有页被释放
+            unpin_cv_.wait(lock);
+            continue;
+        }
+
+        // 如果是脏页，先写回磁盘（期间释放全局锁），之后重新挑选
+        CachePage& victim = pages_[victim_index];
+        if (victim.dirty) {
+            write_back_page_locked(lock, victim_index);
+            continue;
+        }
+
+        // 从映射和队列中移除旧的块
+        block_to_page_.erase(victim.block_no);
+        fifo_of(victim.cls).erase(victim.fifo_pos);
 
         // **[修复]** 重置被替换页的块号，增加健壮性
-        pages_[victim_index].block_no = UINT32_MAX;
+        victim.block_no = UINT32_MAX;
+        victim.state = PageState::FREE;
 
         return victim_index;
     }
+}
 
-    return -1; // 不应该发生，除非缓存大小为0
+// 命中时若调用方给出的类别与页当前类别不同，则把页迁移到对应类别的队尾
+void CacheManager::touch_class(const uint32_t page_index, const CacheClass cls) {
+    CachePage& page = pages_[page_index];
+    if (page.cls == cls) {
+        return;
+    }
+    fifo_of(page.cls).erase(page.fifo_pos);
+    page.cls = cls;
+    auto& fifo = fifo_of(cls);
+    page.fifo_pos = fifo.insert(fifo.end(), page_index);
 }
 
-void CacheManager::write_back_page(const size_t page_index) {
-    if (pages_[page_index].block_no != UINT32_MAX && pages_[page_index].dirty) {
-        if (!disk_->write_block(pages_[page_index].block_no, pages_[page_index].data.data())) {
-            // 在真实系统中，这里需要更复杂的错误处理
-            std::cerr << "Fatal: Failed to write back cache page for block " << pages_[page_index].block_no << std::endl;
-        }
-        pages_[page_index].dirty = false;
+std::list<uint32_t>& CacheManager::fifo_of(const CacheClass cls) {
+    return cls == CacheClass::METADATA ? meta_fifo_ : data_fifo_;
+}
+
+// 回写脏页：先清除脏标记并进入WRITEBACK状态，释放全局锁后持共享闩锁写盘
+void CacheManager::write_back_page_locked(UniqueLock<SimpleMutex>& lock, const size_t page_index) {
+    CachePage& page = pages_[page_index];
+    if (page.block_no == UINT32_MAX || !page.dirty || page.state != PageState::VALID) {
+        return;
+    }
+
+    page.dirty = false;
+    page.state = PageState::WRITEBACK;
+    page.pin_count++;
+    const uint32_t block_no = page.block_no;
+    lock.unlock();
+
+    bool ok;
+    {
+        ReadWriteLock::ReadGuard latch(page.latch);
+        ok = disk_->write_block(block_no, page.data.data());
     }
+
+    lock.lock();
+    if (!ok) {
+        // 在真实系统中，这里需要更复杂的错误处理
+        std::cerr << "Fatal: Failed to write back cache page for block " << block_no << std::endl;
+    } else {
+        ++disk_writes_;
+    }
+    page.state = PageState::VALID;
+    page.pin_count--;
+    page.state_cv.notify_all();
+    unpin_cv_.notify_all();
 }
 
 void CacheManager::print_status() const {
-    // ReadWriteLock::ReadGuard lock(rw_lock_);
+    LockGuard<SimpleMutex> lock(mutex_);
 
     uint32_t dirty_pages = 0;
     uint32_t used_pages = 0;
 
     for (const auto& page : pages_) {
-        if (page.block_no != UINT32_MAX) {
+        if (page.state != PageState::FREE) {
             used_pages++;
             if (page.dirty) {
                 dirty_pages++;
@@ -181,13 +490,285 @@ void CacheManager::print_status() const {
                   << (static_cast<double>(dirty_pages) / used_pages * 100.0) << "%" << std::endl;
     }
 
-    std::cout << "FIFO队列长度: " << fifo_queue_.size() << std::endl;
+    const CacheStats stats = get_stats();
+    std::cout << "命中/未命中: " << stats.hits << " / " << stats.misses
+              << " (命中率 " << std::fixed << std::setprecision(2) << stats.hit_ratio() * 100.0 << "%)" << std::endl;
+    std::cout << "磁盘读/写块数: " << stats.disk_reads << " / " << stats.disk_writes << std::endl;
+
+    std::cout << "FIFO队列长度: 数据 " << data_fifo_.size() << " / 元数据 " << meta_fifo_.size()
+              << " (元数据配额 " << metadata_quota_ << ")" << std::endl;
+
+    // 缺失率曲线：预测不同缓存大小下的命中率
+    std::cout << "缺失率曲线 (SHARDS采样率 " << std::setprecision(3) << stats.mrc_sample_rate
+              << ", 采样引用 " << stats.mrc_sampled_refs << "):" << std::endl;
+    if (stats.mrc.empty()) {
+        std::cout << "  (样本不足)" << std::endl;
+    }
+    for (const auto& point : stats.mrc) {
+        std::cout << "  " << std::setw(8) << point.pages << " 页 ("
+                  << std::setw(10) << std::setprecision(2) << (point.pages * block_size_ / 1024.0 / 1024.0) << " MiB): 预测命中率 "
+                  << std::setprecision(2) << (1.0 - point.miss_ratio) * 100.0 << "%" << std::endl;
+    }
 
     for (auto & page : pages_) {
         std::cout << "Page Block No: " << page.block_no
+                  << ", Class: " << (page.cls == CacheClass::METADATA ? "Meta" : "Data")
                   << ", Dirty: " << (page.dirty ? "Yes" : "No")
                   << ", Access Time: " << std::ctime(&page.access_time) << std::endl;
         std::cout << "------------------------------------------------" << std::endl;
     }
     std::cout << std::endl;
+}
+
+/**
+ * 预取一段连续块到缓存（WILLNEED）
+ * 单次最多预取半个缓存，超出部分交给顺序预读按需完成
+ * @return 实际装入的块数
+ */
+size_t CacheManager::prefetch(const uint32_t start_block, const uint32_t count, const CacheClass cls) {
+    const uint32_t total_blocks = disk_->get_total_blocks();
+    if (count == 0 || start_block >= total_blocks) {
+        return 0;
+    }
+    const auto limit = static_cast<uint32_t>(std::max<size_t>(1, page_count_ / 2));
+    const uint32_t length = std::min({count, limit, total_blocks - start_block});
+    return load_run(start_block, length, cls);
+}
+
+/**
+ * 对块区间给出访问建议，语义参照 posix_fadvise
+ * NORMAL 清除区间上的建议；WILLNEED 立即预取；DONTNEED 回写并丢弃区间内的缓存页；
+ * SEQUENTIAL 在区间内按窗口预读；NOREUSE 使区间内新装入的页最先被置换
+ * cls 为 WILLNEED 预取的页所属类别，元数据块应装入元数据层
+ */
+void CacheManager::advise(const uint32_t start_block, const uint32_t count, const CacheAdvice advice,
+                          const CacheClass cls) {
+    if (count == 0) {
+        return;
+    }
+    const uint32_t end_block = start_block + std::min(count, UINT32_MAX - start_block);
+
+    switch (advice) {
+        case CacheAdvice::WILLNEED:
+            prefetch(start_block, count, cls);
+            return;
+        case CacheAdvice::DONTNEED:
+            drop_range(start_block, end_block);
+            return;
+        default:
+            break;
+    }
+
+    LockGuard<SimpleMutex> lock(mutex_);
+
+    // 与新区间重叠的旧区间被裁剪，只保留不重叠的部分；
+    // 完全覆盖新区间的旧建议与新建议叠加（例如 SEQUENTIAL | NOREUSE）
+    uint8_t flags = advice_flag(advice);
+    std::vector<std::pair<uint32_t, AdviceRegion>> kept;
+    for (auto it = advice_regions_.begin(); it != advice_regions_.end();) {
+        const uint32_t region_start = it->first;
+        const AdviceRegion region = it->second;
+        if (region.end_block <= start_block || region_start >= end_block) {
+            ++it;
+            continue;
+        }
+        if (region_start < start_block) {
+            kept.push_back({region_start, {start_block, region.flags}});
+        }
+        if (region.end_block > end_block) {
+            kept.push_back({end_block, {region.end_block, region.flags}});
+        }
+        if (advice != CacheAdvice::NORMAL && region_start <= start_block && region.end_block >= end_block) {
+            flags |= region.flags;
+        }
+        it = advice_regions_.erase(it);
+    }
+    for (const auto& [region_start, region] : kept) {
+        advice_regions_[region_start] = region;
+    }
+
+    if (advice != CacheAdvice::NORMAL) {
+        advice_regions_[start_block] = {end_block, flags};
+    }
+}
+
+uint8_t CacheManager::advice_flag(const CacheAdvice advice) {
+    switch (advice) {
+        case CacheAdvice::SEQUENTIAL: return ADVICE_FLAG_SEQUENTIAL;
+        case CacheAdvice::NOREUSE: return ADVICE_FLAG_NOREUSE;
+        default: return 0;
+    }
+}
+
+uint8_t CacheManager::advice_flags_locked(const uint32_t block_no) const {
+    auto it = advice_regions_.upper_bound(block_no);
+    if (it == advice_regions_.begin()) {
+        return 0;
+    }
+    --it;
+    return block_no < it->second.end_block ? it->second.flags : 0;
+}
+
+// 顺序区间内下一块尚未缓存时，预读一个窗口（不越过区间末尾）
+void CacheManager::readahead(const uint32_t block_no, const CacheClass cls) {
+    uint32_t window;
+    {
+        LockGuard<SimpleMutex> lock(mutex_);
+        if (!(advice_flags_locked(block_no) & ADVICE_FLAG_SEQUENTIAL)) {
+            return;
+        }
+        const uint32_t next = block_no + 1;
+        if (find_page(next) != -1) {
+            return;
+        }
+        const auto it = std::prev(advice_regions_.upper_bound(block_no));
+        window = std::min(static_cast<uint32_t>(std::max<size_t>(1, page_count_ / 4)),
+                          it->second.end_block - next);
+    }
+    if (window > 0) {
+        prefetch(block_no + 1, window, cls);
+    }
+}
+
+// 回写并丢弃区间 [start_block, end_block) 内未被钉住的缓存页
+void CacheManager::drop_range(const uint32_t start_block, const uint32_t end_block) {
+    UniqueLock<SimpleMutex> lock(mutex_);
+    for (size_t i = 0; i < pages_.size(); ++i) {
+        CachePage& page = pages_[i];
+        if (page.block_no < start_block || page.block_no >= end_block) {
+            continue;
+        }
+        if (page.state == PageState::VALID && page.dirty) {
+            write_back_page_locked(lock, i);
+        }
+        // 回写期间锁曾被释放，需要重新检查
+        if (page.block_no < start_block || page.block_no >= end_block ||
+            page.state != PageState::VALID || page.dirty || page.pin_count != 0) {
+            continue;
+        }
+        block_to_page_.erase(page.block_no);
+        fifo_of(page.cls).erase(page.fifo_pos);
+        page.block_no = UINT32_MAX;
+        page.state = PageState::FREE;
+    }
+    unpin_cv_.notify_all();
+}
+
+size_t CacheManager::get_page_count() const {
+    return page_count_;
+}
+
+std::vector<HotBlock> CacheManager::get_hot_set() const {
+    LockGuard<SimpleMutex> lock(mutex_);
+
+    std::vector<HotBlock> hot_set;
+    for (const auto& page : pages_) {
+        if (page.state != PageState::FREE && page.block_no != UINT32_MAX) {
+            hot_set.push_back({page.block_no, page.access_count, page.cls});
+        }
+    }
+    return hot_set;
+}
+
+/**
+ * 保存当前驻留块列表（卸载时调用）
+ * 文件格式：魔数、记录数，随后为 HotBlock 记录数组
+ */
+bool CacheManager::save_hot_set(const std::string& path) const {
+    const std::vector<HotBlock> hot_set = get_hot_set();
+
+    std::ofstream out(path, std::ios::out | std::ios::binary | std::ios::trunc);
+    if (!out.is_open()) {
+        std::cerr << "Warning: Failed to save cache hot set: " << path << std::endl;
+        return false;
+    }
+
+    const uint32_t magic = HOT_SET_MAGIC;
+    const auto count = static_cast<uint32_t>(hot_set.size());
+    out.write(reinterpret_cast<const char*>(&magic), sizeof(magic));
+    out.write(reinterpret_cast<const char*>(&count), sizeof(count));
+    out.write(reinterpret_cast<const char*>(hot_set.data()),
+              static_cast<std::streamsize>(hot_set.size() * sizeof(HotBlock)));
+    return !out.fail();
+}
+
+/**
+ * 按保存的热点集合预热缓存（挂载后调用）
+ * 取访问次数最多的块（不超过缓存容量），按块号排序后合并为连续区间批量读取
+ * @return 预热装入的块数
+ */
+size_t CacheManager::prewarm(const std::string& path) {
+    std::ifstream in(path, std::ios::in | std::ios::binary);
+    if (!in.is_open()) {
+        return 0; // 没有保存的热点集合，冷启动
+    }
+
+    uint32_t magic = 0;
+    uint32_t count = 0;
+    in.read(reinterpret_cast<char*>(&magic), sizeof(magic));
+    in.read(reinterpret_cast<char*>(&count), sizeof(count));
+    if (in.fail() || magic != HOT_SET_MAGIC) {
+        return 0;
+    }
+
+    // 记录数不可信：不能超过文件剩余长度能容纳的记录数，也不能超过上限
+    const std::streampos records_pos = in.tellg();
+    in.seekg(0, std::ios::end);
+    const std::streamoff remaining = in.tellg() - records_pos;
+    in.seekg(records_pos);
+    if (in.fail() || remaining < 0) {
+        return 0;
+    }
+    count = static_cast<uint32_t>(std::min<uint64_t>({count,
+                                                      static_cast<uint64_t>(remaining) / sizeof(HotBlock),
+                                                      HOT_SET_MAX_RECORDS}));
+
+    std::vector<HotBlock> hot_set(count);
+    in.read(reinterpret_cast<char*>(hot_set.data()), static_cast<std::streamsize>(count * sizeof(HotBlock)));
+    if (in.fail()) {
+        return 0;
+    }
+
+    const uint32_t total_blocks = disk_->get_total_blocks();
+    hot_set.erase(std::remove_if(hot_set.begin(), hot_set.end(),
+                                 [total_blocks](const HotBlock& hot) {
+                                     return hot.block_no >= total_blocks ||
+                                            (hot.cls != CacheClass::DATA && hot.cls != CacheClass::METADATA);
+                                 }),
+                  hot_set.end());
+
+    // 只保留最热的部分，再按块号排序以便合并
+    if (hot_set.size() > page_count_) {
+        std::partial_sort(hot_set.begin(), hot_set.begin() + page_count_, hot_set.end(),
+                          [](const HotBlock& a, const HotBlock& b) { return a.access_count > b.access_count; });
+        hot_set.resize(page_count_);
+    }
+    std::sort(hot_set.begin(), hot_set.end(),
+              [](const HotBlock& a, const HotBlock& b) { return a.block_no < b.block_no; });
+
+    size_t loaded = 0;
+    size_t i = 0;
+    while (i < hot_set.size()) {
+        // 合并块号连续且类别相同的记录
+        size_t j = i + 1;
+        while (j < hot_set.size() && hot_set[j].block_no == hot_set[j - 1].block_no + 1 &&
+               hot_set[j].cls == hot_set[i].cls) {
+            ++j;
+        }
+        loaded += load_run(hot_set[i].block_no, static_cast<uint32_t>(j - i), hot_set[i].cls);
+        i = j;
+    }
+    return loaded;
+}
+
+CacheStats CacheManager::get_stats() const {
+    CacheStats stats;
+    stats.hits = hits_.load();
+    stats.misses = misses_.load();
+    stats.disk_reads = disk_reads_.load();
+    stats.disk_writes = disk_writes_.load();
+    stats.mrc_sampled_refs = mrc_.get_sampled_refs();
+    stats.mrc_sample_rate = mrc_.get_sample_rate();
+    stats.mrc = mrc_.curve(disk_->get_total_blocks());
+    return stats;
 }
\ No newline at end of file
@@ -1,46 +1,194 @@
 #pragma once
 
 #include <vector>
-#include <queue>
+#include <list>
+#include <map>
 #include <mutex>
+#include <condition_variable>
 #include <unordered_map>
+#include <atomic>
+#include <string>
 
 #include "disk.h"
+#include "mrc.h"
 #include "../process/sync.h"
 
 #define CACHE_PAGES 16          // 缓冲页数量
+#define CACHE_METADATA_RATIO 0.5 // 元数据页受保护的最大占比
+#define HOT_SET_MAGIC 0x484F5453 // 热点集合文件魔数 "HOTS"
+#define HOT_SET_MAX_RECORDS 65536 // 热点集合文件记录数上限（超出视为损坏）
 
+// 缓存页的优先级类别
+enum class CacheClass : uint8_t {
+    DATA,       // 普通文件数据
+    METADATA    // 位图、inode表、目录块
+};
+
+// 缓存页状态
+enum class PageState : uint8_t {
+    FREE,       // 未使用
+    LOADING,    // 正在从磁盘装入（或等待整块写入），其他线程需在该页上等待
+    VALID,      // 数据有效
+    WRITEBACK   // 正在回写磁盘，可读不可写
+};
+
+/**
+ * 缓存页
+ * block_no/state/dirty/pin_count 等元信息由 CacheManager 的全局锁保护，
+ * 页数据由每页的闩锁保护，磁盘I/O期间不持有全局锁
+ */
 struct CachePage {
-    uint32_t block_no;              // 缓存的块号
-    bool dirty;                     // 脏标记
-    time_t access_time;             // 访问时间（用于FIFO）
+    uint32_t block_no = UINT32_MAX; // 缓存的块号
+    PageState state = PageState::FREE; // 页状态
+    bool dirty = false;             // 脏标记
+    CacheClass cls = CacheClass::DATA; // 页所属类别
+    uint32_t pin_count = 0;         // 引用计数，非零时不可被置换
+    uint32_t access_count = 0;      // 装入以来的访问次数
+    time_t access_time = 0;         // 访问时间（用于FIFO）
     std::vector<uint8_t> data;      // 缓存数据
+    std::list<uint32_t>::iterator fifo_pos; // 在所属FIFO队列中的位置
+    ReadWriteLock latch;            // 页数据闩锁
+    std::condition_variable state_cv; // 等待本页装入/回写完成
+};
+
+// 块区间访问建议（参照 posix_fadvise）
+enum class CacheAdvice : uint8_t {
+    NORMAL,     // 清除建议
+    WILLNEED,   // 即将访问，立即预取
+    DONTNEED,   // 不再需要，回写并丢弃
+    SEQUENTIAL, // 顺序访问，按窗口预读
+    NOREUSE     // 只访问一次，装入的页最先被置换
+};
+
+// 热点块记录（用于卸载时保存、挂载后预热），按原样写入文件，填充字节显式置零
+struct HotBlock {
+    uint32_t block_no = 0;          // 块号
+    uint32_t access_count = 0;      // 访问次数
+    CacheClass cls = CacheClass::DATA; // 页类别
+    uint8_t reserved[3] = {};       // 保留（填充）
+};
+
+// 缓存统计信息
+struct CacheStats {
+    uint64_t hits = 0;              // 命中次数
+    uint64_t misses = 0;            // 未命中次数
+    uint64_t disk_reads = 0;        // 实际磁盘读块数
+    uint64_t disk_writes = 0;       // 实际磁盘写块数
+    uint64_t mrc_sampled_refs = 0;  // MRC采样到的引用数
+    double mrc_sample_rate = 0.0;   // MRC采样率
+    std::vector<MrcPoint> mrc;      // 预测的缺失率曲线（LRU）
+
+    double hit_ratio() const {
+        const uint64_t total = hits + misses;
+        return total == 0 ? 0.0 : static_cast<double>(hits) / total;
+    }
+};
+
+class CacheManager;
+
+/**
+ * 钉住的只读缓存页（由 CacheManager::pin_block 返回）
+ * 持有期间页不会被置换，并持有页数据的共享闩锁，可直接读取页内数据而无需复制；
+ * 析构或 release 时解除，只能移动不能复制
+ */
+class PinnedPage {
+public:
+    PinnedPage() = default;
+    PinnedPage(PinnedPage&& other) noexcept;
+    PinnedPage& operator=(PinnedPage&& other) noexcept;
+    PinnedPage(const PinnedPage&) = delete;
+    PinnedPage& operator=(const PinnedPage&) = delete;
+    ~PinnedPage() { release(); }
+
+    const uint8_t* data() const { return data_; }
+    bool valid() const { return page_index_ != -1; }
+    void release();
+
+private:
+    friend class CacheManager;
+    CacheManager* cache_ = nullptr;
+    int page_index_ = -1;
+    const uint8_t* data_ = nullptr;
 };
 
 class CacheManager {
 public:
-    explicit CacheManager(VirtualDisk* disk, size_t page_count = CACHE_PAGES, size_t block_size = 4096);
+    explicit CacheManager(VirtualDisk* disk, size_t page_count = CACHE_PAGES, size_t block_size = 4096,
+                          double metadata_ratio = CACHE_METADATA_RATIO);
     ~CacheManager();
 
-    bool read_block(uint32_t block_no, void* buffer);
-    bool write_block(uint32_t block_no, const void* buffer);
+    bool read_block(uint32_t block_no, void* buffer, CacheClass cls = CacheClass::DATA);
+    // 整块覆盖写：未命中时直接分配缓存页，不从磁盘预读旧数据
+    bool write_block(uint32_t block_no, const void* buffer, CacheClass cls = CacheClass::DATA);
+    // 块内部分写：未命中时先读入旧数据再修改（read-modify-write）
+    bool write_partial(uint32_t block_no, size_t offset, const void* buffer, size_t size,
+                       CacheClass cls = CacheClass::DATA);
+    /**
+     * 钉住块所在的缓存页供直接读取（零拷贝），顺序访问区间内同样触发预读
+     * 持有期间不要写同一块；同时钉住的页不宜超过缓存的一小部分
+     * @return 失败时返回的对象 valid() 为false
+     */
+    PinnedPage pin_block(uint32_t block_no, CacheClass cls = CacheClass::DATA);
     void flush_all();
     void print_status() const;
+    CacheStats get_stats() const;
+
+    // 热点集合持久化与预热
+    std::vector<HotBlock> get_hot_set() const;
+    bool save_hot_set(const std::string& path) const;
+    size_t prewarm(const std::string& path);
+
+    // 显式预取与访问建议
+    size_t prefetch(uint32_t start_block, uint32_t count, CacheClass cls = CacheClass::DATA);
+    void advise(uint32_t start_block, uint32_t count, CacheAdvice advice, CacheClass cls = CacheClass::DATA);
+    size_t get_page_count() const;
 
 private:
+    friend class PinnedPage;
+
     VirtualDisk* disk_;
     std::vector<CachePage> pages_;
-    std::queue<uint32_t> fifo_queue_;
+    std::list<uint32_t> data_fifo_;         // 数据页FIFO队列
+    std::list<uint32_t> meta_fifo_;         // 元数据页FIFO队列
     std::unordered_map<uint32_t, uint32_t> block_to_page_;
-    std::mutex mutex_;
+    mutable SimpleMutex mutex_;             // 保护映射表、FIFO队列与页元信息
+    std::condition_variable unpin_cv_;      // 所有页都被钉住时等待释放
 
-    ReadWriteLock rw_lock_;
+    // 访问建议区间：起始块 -> {结束块(不含), 建议标志}
+    static constexpr uint8_t ADVICE_FLAG_SEQUENTIAL = 0x1;
+    static constexpr uint8_t ADVICE_FLAG_NOREUSE = 0x2;
+    struct AdviceRegion {
+        uint32_t end_block;
+        uint8_t flags;
+    };
+    std::map<uint32_t, AdviceRegion> advice_regions_;
 
     const size_t page_count_;
     const size_t block_size_;
+    const size_t metadata_quota_;           // 元数据页受保护的页数上限
+
+    // 统计信息
+    std::atomic<uint64_t> hits_{0};
+    std::atomic<uint64_t> misses_{0};
+    std::atomic<uint64_t> disk_reads_{0};
+    std::atomic<uint64_t> disk_writes_{0};
+    MissRatioCurve mrc_;
 
     // 内部辅助方法
+    // 以下 *_locked 方法要求调用方持有 mutex_
     int find_page(uint32_t block_no);
-    int get_free_page();
-    void write_back_page(size_t page_index);
-};
\ No newline at end of file
+    int pin_page(uint32_t block_no, bool fetch, CacheClass cls, bool& loading);
+    void unpin_page(uint32_t page_index, bool dirtied, bool loaded);
+    void release_pinned(int page_index);
+    size_t load_run(uint32_t start_block, uint32_t count, CacheClass cls);
+    void attach_page_locked(int page_index, uint32_t block_no, CacheClass cls);
+    void readahead(uint32_t block_no, CacheClass cls);
+    void drop_range(uint32_t start_block, uint32_t end_block);
+    static uint8_t advice_flag(CacheAdvice advice);
+    uint8_t advice_flags_locked(uint32_t block_no) const;
+    int get_free_page_locked(UniqueLock<SimpleMutex>& lock, CacheClass incoming);
+    int pick_victim_locked(const std::list<uint32_t>& fifo) const;
+    void touch_class(uint32_t page_index, CacheClass cls);
+    std::list<uint32_t>& fifo_of(CacheClass cls);
+    void write_back_page_locked(UniqueLock<SimpleMutex>& lock, size_t page_index);
+};
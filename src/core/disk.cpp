@@ -58,7 +58,8 @@ bool VirtualDisk::create(const std::string& filename, const size_t size_mb) {
  * @return 读取成功返回true，失败返回false
  */
 bool VirtualDisk::read_block(const uint32_t block_no, void* buffer) {
-    // ReadWriteLock::ReadGuard read_guard(disk_lock_); // 使用读锁保护磁盘读取操作
+    // 文件流的读写位置是共享的，读操作同样需要独占锁
+    ReadWriteLock::WriteGuard write_guard(disk_lock_);
 
     if (!buffer) {
         std::cerr << "Error: Invalid buffer pointer" << std::endl;
@@ -105,7 +106,7 @@ bool VirtualDisk::read_block(const uint32_t block_no, void* buffer) {
  * @return 写入成功返回true，失败返回false
  */
 bool VirtualDisk::write_block(const uint32_t block_no, const void* buffer) {
-    // ReadWriteLock::WriteGuard write_guard(disk_lock_); // 使用写锁保护磁盘写入操作
+    ReadWriteLock::WriteGuard write_guard(disk_lock_); // 使用写锁保护磁盘写入操作
 
     if (!buffer) {
         std::cerr << "Error: Invalid buffer pointer" << std::endl;
@@ -147,6 +148,50 @@ bool VirtualDisk::write_block(const uint32_t block_no, const void* buffer) {
     return true;
 }
 
+/**
+ * 一次读取连续的多个磁盘块（合并I/O，一次定位一次读取）
+ * @param start_block 起始块号
+ * @param count 块数
+ * @param buffer 读取缓冲区，大小至少为 count * 块大小
+ * @return 读取成功返回true，失败返回false
+ */
+bool VirtualDisk::read_blocks(const uint32_t start_block, const uint32_t count, void* buffer) {
+    ReadWriteLock::WriteGuard write_guard(disk_lock_);
+
+    if (!buffer) {
+        std::cerr << "Error: Invalid buffer pointer" << std::endl;
+        return false;
+    }
+
+    if (!file_stream_.is_open()) {
+        std::cerr << "Error: Disk file is not open" << std::endl;
+        return false;
+    }
+
+    if (count == 0 || start_block >= total_blocks_ || count > total_blocks_ - start_block) {
+        std::cerr << "Error: Block range " << start_block << "+" << count << " exceeds disk capacity ("
+                  << total_blocks_ << " blocks)" << std::endl;
+        return false;
+    }
+
+    const std::streampos offset = static_cast<std::streampos>(start_block) * block_size_;
+    file_stream_.seekg(offset);
+    if (file_stream_.fail()) {
+        std::cerr << "Error: Failed to seek to block " << start_block << std::endl;
+        return false;
+    }
+
+    const auto bytes = static_cast<std::streamsize>(count) * static_cast<std::streamsize>(block_size_);
+    file_stream_.read(static_cast<char*>(buffer), bytes);
+    if (file_stream_.fail() || file_stream_.gcount() != bytes) {
+        std::cerr << "Error: Failed to read blocks " << start_block << "+" << count << std::endl;
+        file_stream_.clear();
+        return false;
+    }
+
+    return true;
+}
+
 bool VirtualDisk::copy_blocks(const uint32_t src_block, const uint32_t dst_block, const uint32_t count) {
     // ReadWriteLock::WriteGuard write_guard(disk_lock_); // 使用写锁保护块复制操作
 
@@ -30,6 +30,7 @@ public:
     bool create(const std::string& filename, size_t size_mb);
     bool read_block(uint32_t block_no, void* buffer);
     bool write_block(uint32_t block_no, const void* buffer);
+    bool read_blocks(uint32_t start_block, uint32_t count, void* buffer);
     bool copy_blocks(uint32_t src_block, uint32_t dst_block, uint32_t count);
     bool open(const std::string& filename);
     uint32_t get_total_blocks() const;
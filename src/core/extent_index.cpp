@@ -0,0 +1,100 @@
+#include "extent_index.h"
+#include <algorithm>
+
+void FreeExtentIndex::add_extent(const uint32_t start, const uint32_t length) {
+    by_start_[start] = length;
+    by_length_.insert({length, start});
+}
+
+void FreeExtentIndex::erase_extent(const std::map<uint32_t, uint32_t>::iterator it) {
+    by_length_.erase({it->second, it->first});
+    by_start_.erase(it);
+}
+
+void FreeExtentIndex::clear() {
+    by_start_.clear();
+    by_length_.clear();
+}
+
+void FreeExtentIndex::insert(uint32_t start, uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+
+    // 与后一个区段相邻则合并
+    auto next = by_start_.lower_bound(start);
+    if (next != by_start_.end() && next->first == start + length) {
+        length += next->second;
+        erase_extent(next);
+    }
+
+    // 与前一个区段相邻则合并
+    auto prev = by_start_.lower_bound(start);
+    if (prev != by_start_.begin()) {
+        --prev;
+        if (prev->first + prev->second == start) {
+            start = prev->first;
+            length += prev->second;
+            erase_extent(prev);
+        }
+    }
+
+    add_extent(start, length);
+}
+
+void FreeExtentIndex::remove(const uint32_t start, const uint32_t length) {
+    if (length == 0) {
+        return;
+    }
+    const uint64_t end = static_cast<uint64_t>(start) + length;
+
+    // 从可能覆盖start的区段开始，裁掉所有与 [start, end) 重叠的部分
+    auto it = by_start_.upper_bound(start);
+    if (it != by_start_.begin()) {
+        --it;
+    }
+    while (it != by_start_.end() && it->first < end) {
+        const uint32_t extent_start = it->first;
+        const uint64_t extent_end = static_cast<uint64_t>(extent_start) + it->second;
+        if (extent_end <= start) {
+            ++it;
+            continue;
+        }
+
+        auto next = std::next(it);
+        erase_extent(it);
+        if (extent_start < start) {
+            add_extent(extent_start, start - extent_start);
+        }
+        if (extent_end > end) {
+            add_extent(static_cast<uint32_t>(end), static_cast<uint32_t>(extent_end - end));
+        }
+        it = next;
+    }
+}
+
+uint32_t FreeExtentIndex::best_fit(const uint32_t count) const {
+    const auto it = by_length_.lower_bound({count, 0});
+    return it == by_length_.end() ? UINT32_MAX : it->second;
+}
+
+uint32_t FreeExtentIndex::nearest_fit(const uint32_t count, const uint32_t goal, const size_t max_probes) const {
+    auto it = by_start_.upper_bound(goal);
+    if (it != by_start_.begin()) {
+        const auto containing = std::prev(it);
+        const uint64_t extent_end = static_cast<uint64_t>(containing->first) + containing->second;
+        if (extent_end > goal && extent_end - goal >= count) {
+            return goal;
+        }
+    }
+    for (size_t probes = 0; it != by_start_.end() && probes < max_probes; ++it, ++probes) {
+        if (it->second >= count) {
+            return it->first;
+        }
+    }
+    return UINT32_MAX;
+}
+
+uint32_t FreeExtentIndex::largest() const {
+    return by_length_.empty() ? 0 : by_length_.rbegin()->first;
+}
@@ -0,0 +1,82 @@
+#ifndef EXTENT_INDEX_H
+#define EXTENT_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <map>
+#include <set>
+#include <utility>
+
+/**
+ * 空闲区段索引
+ * 同时按起始块号和按长度索引所有空闲区段：
+ * 按起始块号用于释放时与相邻区段合并，按长度用于 O(log n) 的最佳适配查找
+ */
+class FreeExtentIndex
+{
+    std::map<uint32_t, uint32_t> by_start_;                 // 起始块号 -> 长度
+    std::set<std::pair<uint32_t, uint32_t>> by_length_;     // (长度, 起始块号)
+
+    void add_extent(uint32_t start, uint32_t length);
+    void erase_extent(std::map<uint32_t, uint32_t>::iterator it);
+
+public:
+    /**
+     * 清空索引
+     */
+    void clear();
+
+    /**
+     * 加入一段空闲块，并与前后相邻的区段合并
+     * @param start 起始块号
+     * @param length 块数
+     */
+    void insert(uint32_t start, uint32_t length);
+
+    /**
+     * 从索引中扣除一段块（分配时调用），必要时拆分所在区段
+     * @param start 起始块号
+     * @param length 块数
+     */
+    void remove(uint32_t start, uint32_t length);
+
+    /**
+     * 最佳适配：长度不小于count的最短区段
+     * @param count 需要的连续块数
+     * @return 区段起始块号，没有返回UINT32_MAX
+     */
+    uint32_t best_fit(uint32_t count) const;
+
+    /**
+     * 就近适配：若goal所在区段从goal起能放下count块则返回goal，
+     * 否则返回goal之后第一个长度足够的区段
+     * @param count 需要的连续块数
+     * @param goal 目标块号
+     * @param max_probes 向后最多检查的区段数
+     * @return 起始块号，没有返回UINT32_MAX
+     */
+    uint32_t nearest_fit(uint32_t count, uint32_t goal, size_t max_probes) const;
+
+    /**
+     * 最大空闲区段长度
+     */
+    uint32_t largest() const;
+
+    /**
+     * 区段数量
+     */
+    size_t size() const
+    {
+        return by_start_.size();
+    }
+
+    /**
+     * 所有区段（按起始块号有序）
+     */
+    const std::map<uint32_t, uint32_t>& extents() const
+    {
+        return by_start_;
+    }
+};
+
+#endif //EXTENT_INDEX_H
@@ -0,0 +1,75 @@
+#include "file_reader.h"
+#include <algorithm>
+
+// 空洞返回的全0块
+static const char zero_block[BLOCK_SIZE] = {};
+
+FileReader::FileReader(const INodeManager* inodes, CacheManager* cache, const uint32_t inode_id)
+    : cache_(cache) {
+    if (!inodes->get_layout(inode_id, inode_, extents_)) {
+        return;
+    }
+    open_ = true;
+    cls_ = INodeManager::cache_class_of(inode_);
+
+    // 告知缓存这是一次顺序扫描；超过半个缓存的大文件只读一遍，不应挤掉工作集
+    if (inode_.block_count > 1) {
+        const bool no_reuse = inode_.block_count > cache_->get_page_count() / 2;
+        for (const Extent& extent : extents_) {
+            cache_->advise(extent.start, extent.count, CacheAdvice::SEQUENTIAL);
+            if (no_reuse) {
+                cache_->advise(extent.start, extent.count, CacheAdvice::NOREUSE);
+            }
+        }
+        advised_ = true;
+    }
+}
+
+FileReader::~FileReader() {
+    page_.release();
+    if (advised_) {
+        for (const Extent& extent : extents_) {
+            cache_->advise(extent.start, extent.count, CacheAdvice::NORMAL);
+        }
+    }
+}
+
+bool FileReader::next(const char*& data, size_t& length) {
+    // 先放开上一次返回的页，任何时刻只钉住一个页
+    page_.release();
+    if (!open_ || failed_ || position_ >= inode_.size) {
+        return false;
+    }
+
+    if (inode_.flags & INODE_FLAG_INLINE) {
+        data = inode_.inline_data;
+        length = std::min<uint32_t>(inode_.size, INODE_INLINE_DATA_MAX);
+        position_ = inode_.size;
+        return true;
+    }
+
+    // 顺序读取，区段游标只会向后移动
+    const uint32_t block_index = position_ / BLOCK_SIZE;
+    while (extent_index_ < extents_.size() &&
+           block_index >= extents_[extent_index_].logical + extents_[extent_index_].count) {
+        ++extent_index_;
+    }
+    length = std::min<uint32_t>(BLOCK_SIZE, inode_.size - position_);
+    position_ += length;
+
+    // 未映射的块是空洞，读出为0
+    if (extent_index_ == extents_.size() || block_index < extents_[extent_index_].logical) {
+        data = zero_block;
+        return true;
+    }
+
+    const Extent& extent = extents_[extent_index_];
+    page_ = cache_->pin_block(extent.start + (block_index - extent.logical), cls_);
+    if (!page_.valid()) {
+        failed_ = true;
+        return false;
+    }
+
+    data = reinterpret_cast<const char*>(page_.data());
+    return true;
+}
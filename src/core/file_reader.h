@@ -0,0 +1,66 @@
+#ifndef FILE_READER_H
+#define FILE_READER_H
+
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "cache.h"
+#include "inode.h"
+
+/**
+ * 顺序流式读取文件
+ * 按块依次返回缓存页中的数据，每次只钉住一个页，不复制数据，内存占用与文件大小无关；
+ * 打开时对文件的各区段设置顺序访问建议以触发预读，关闭时清除
+ */
+class FileReader
+{
+    CacheManager* cache_;
+    INode inode_{};                 // 打开时的inode副本（内联数据直接从这里返回）
+    std::vector<Extent> extents_;   // 区段表
+    CacheClass cls_ = CacheClass::DATA;
+    size_t extent_index_ = 0;       // 当前所在区段
+    uint32_t position_ = 0;         // 下一次返回数据的文件偏移
+    PinnedPage page_;               // 上一次返回的数据所在的页
+    bool open_ = false;
+    bool failed_ = false;
+    bool advised_ = false;
+
+public:
+    /**
+     * 打开文件，先写回该文件的延迟分配数据
+     * @param inodes inode管理器
+     * @param cache 缓存管理器
+     * @param inode_id 文件的inode号
+     */
+    FileReader(const INodeManager* inodes, CacheManager* cache, uint32_t inode_id);
+    ~FileReader();
+
+    FileReader(const FileReader&) = delete;
+    FileReader& operator=(const FileReader&) = delete;
+
+    /**
+     * 取得下一段数据（通常为一整块）
+     * @param data 数据起始地址，在下一次调用 next 或析构前有效
+     * @param length 数据长度
+     * @return false表示已读完或出错（用 failed 区分）
+     */
+    bool next(const char*& data, size_t& length);
+
+    bool is_open() const
+    {
+        return open_;
+    }
+
+    bool failed() const
+    {
+        return failed_;
+    }
+
+    uint32_t size() const
+    {
+        return inode_.size;
+    }
+};
+
+#endif //FILE_READER_H
@@ -1,20 +1,40 @@
 #include "inode.h"
+#include "file_reader.h"
 #include <cstring>
 #include <cmath>
 #include <iostream>
 #include <sstream>
 #include <string>
+#include <algorithm>
+#include <chrono>
+#include <thread>
 
 // 每个INode结构体大小（字节）
 constexpr uint32_t INODE_SIZE = sizeof(INode);
+static_assert(INODE_SIZE == INODE_RECORD_SIZE, "内联数据区大小需与inode记录大小匹配");
 
 // 每块可存储的INode数量
 constexpr uint32_t INODES_PER_BLOCK = BLOCK_SIZE / INODE_SIZE;
 
+// inode位图每块可描述的inode数量
+constexpr uint32_t INODE_BITMAP_BITS = BLOCK_SIZE * 8;
+
 INodeManager::INodeManager(VirtualDisk* disk, FreeBitmap* bitmap, CacheManager* cache)
     : cache_(cache), disk_(disk), bitmap_(bitmap) {
-    // 初始化inode使用标记
-    inode_used_.resize(max_inodes_, false);
+    // 位图可能占用多个块，其后依次是inode位图与Inode表
+    if (bitmap_) {
+        inode_bitmap_start_ = bitmap_->get_bitmap_start() + bitmap_->get_bitmap_blocks();
+        inode_table_start_ = inode_bitmap_start_ + get_inode_bitmap_blocks();
+    }
+
+    // 初始化inode位图（inode 0 保留不用），由 initialize 从磁盘装入或 format 清空
+    inode_bitmap_.assign((max_inodes_ + 63) / 64, 0);
+    reset_inode_bitmap();
+
+    // 内存inode表，表块在首次访问时装入
+    inode_table_.resize(max_inodes_);
+    table_block_loaded_.resize(get_inode_table_blocks(), false);
+    inode_dirty_.resize(max_inodes_, false);
 
     // 初始化细粒度锁
     // inode_locks_.resize(max_inodes_);
@@ -29,14 +49,137 @@ INodeManager::~INodeManager() {
     directory_cache_.clear();
 }
 
+uint32_t INodeManager::get_inode_table_blocks() {
+    return (MAX_FILES + INODES_PER_BLOCK - 1) / INODES_PER_BLOCK;
+}
+
+uint32_t INodeManager::get_inode_bitmap_blocks() {
+    return (MAX_FILES + INODE_BITMAP_BITS - 1) / INODE_BITMAP_BITS;
+}
+
+uint32_t INodeManager::get_metadata_blocks() {
+    return get_inode_bitmap_blocks() + get_inode_table_blocks();
+}
+
+void INodeManager::reset_inode_bitmap()
+{
+    std::fill(inode_bitmap_.begin(), inode_bitmap_.end(), 0);
+    inode_bitmap_[0] = 1; // inode 0 保留
+    // 最后一个字中超出inode总数的填充位恒为1，按字扫描时不会越界
+    const uint32_t tail_bits = max_inodes_ % 64;
+    if (tail_bits != 0) {
+        inode_bitmap_.back() |= ~0ULL << tail_bits;
+    }
+    inode_count_ = 0;
+    inode_hint_word_ = 0;
+    inode_bitmap_dirty_ = true;
+}
+
 bool INodeManager::initialize()
 {
     // ReadWriteLock::WriteGuard write_guard(inode_lock_);
+    LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
+
+    // 从磁盘装入inode位图，已使用的inode数由位计数得到
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    auto* bytes = reinterpret_cast<uint8_t*>(inode_bitmap_.data());
+    const size_t total_bytes = inode_bitmap_.size() * sizeof(uint64_t);
+    for (uint32_t i = 0; i < get_inode_bitmap_blocks(); ++i) {
+        if (!cache_->read_block(inode_bitmap_start_ + i, block_buffer.data(), CacheClass::METADATA)) {
+            return false;
+        }
+        const size_t offset = static_cast<size_t>(i) * BLOCK_SIZE;
+        memcpy(bytes + offset, block_buffer.data(), std::min<size_t>(BLOCK_SIZE, total_bytes - offset));
+    }
+
+    inode_bitmap_[0] |= 1;
+    const uint32_t tail_bits = max_inodes_ % 64;
+    if (tail_bits != 0) {
+        inode_bitmap_.back() |= ~0ULL << tail_bits;
+    }
+    uint32_t used_bits = 0;
+    for (const uint64_t word : inode_bitmap_) {
+        used_bits += __builtin_popcountll(word);
+    }
+    const uint32_t padding = static_cast<uint32_t>(inode_bitmap_.size() * 64 - max_inodes_);
+    inode_count_ = used_bits - padding - 1;
+    inode_hint_word_ = 0;
+    inode_bitmap_dirty_ = false;
+    return true;
+}
 
-    // 初始化超级块和inode表
-    // 这里简化实现，实际中应该从磁盘读取或初始化
+bool INodeManager::format()
+{
+    LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
+    reset_inode_bitmap();
     return true;
 }
+
+bool INodeManager::save_inode_bitmap() const
+{
+    LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
+    if (!inode_bitmap_dirty_) return true;
+
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    const auto* bytes = reinterpret_cast<const uint8_t*>(inode_bitmap_.data());
+    const size_t total_bytes = inode_bitmap_.size() * sizeof(uint64_t);
+    for (uint32_t i = 0; i < get_inode_bitmap_blocks(); ++i) {
+        const size_t offset = static_cast<size_t>(i) * BLOCK_SIZE;
+        std::fill(block_buffer.begin(), block_buffer.end(), 0);
+        memcpy(block_buffer.data(), bytes + offset, std::min<size_t>(BLOCK_SIZE, total_bytes - offset));
+        if (!cache_->write_block(inode_bitmap_start_ + i, block_buffer.data(), CacheClass::METADATA)) {
+            return false;
+        }
+    }
+    inode_bitmap_dirty_ = false;
+    return true;
+}
+
+bool INodeManager::is_inode_used(const uint32_t inode_id) const
+{
+    return inode_id < max_inodes_ && (inode_bitmap_[inode_id / 64] >> (inode_id % 64) & 1);
+}
+
+int32_t INodeManager::allocate_inode_slot()
+{
+    LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
+
+    // 从上次分配所在的字开始，跳过全满的字，用ctz定位第一个0位
+    const size_t word_count = inode_bitmap_.size();
+    for (size_t k = 0; k < word_count; ++k) {
+        const size_t w = (inode_hint_word_ + k) % word_count;
+        const uint64_t word = inode_bitmap_[w];
+        if (word == ~0ULL) continue;
+        const uint32_t bit = __builtin_ctzll(~word);
+        inode_bitmap_[w] = word | (1ULL << bit);
+        inode_hint_word_ = w;
+        inode_bitmap_dirty_ = true;
+        inode_count_++;
+        return static_cast<int32_t>(w * 64 + bit);
+    }
+    return -1;
+}
+
+bool INodeManager::claim_inode_slot(const uint32_t inode_id)
+{
+    LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
+    if (inode_id >= max_inodes_ || is_inode_used(inode_id)) return false;
+    inode_bitmap_[inode_id / 64] |= 1ULL << (inode_id % 64);
+    inode_bitmap_dirty_ = true;
+    inode_count_++;
+    return true;
+}
+
+void INodeManager::release_inode_slot(const uint32_t inode_id)
+{
+    LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
+    if (inode_id == 0 || !is_inode_used(inode_id)) return;
+    inode_bitmap_[inode_id / 64] &= ~(1ULL << (inode_id % 64));
+    // 释放的槽位在游标之前时把游标移回，保证总是优先复用低编号的inode
+    inode_hint_word_ = std::min<size_t>(inode_hint_word_, inode_id / 64);
+    inode_bitmap_dirty_ = true;
+    inode_count_--;
+}
 bool INodeManager::create_root_directory() {
 
     // 确保位图已初始化
@@ -46,7 +189,7 @@ bool INodeManager::create_root_directory() {
     }
 
     // 创建根目录inode
-    INode root_inode;
+    INode root_inode{};
     root_inode.id = ROOT_INODE_ID;
     root_inode.type = FS_DIRECTORY;
     root_inode.size = 0;
@@ -61,6 +204,8 @@ bool INodeManager::create_root_directory() {
         std::cerr << "Error: 无法为根目录分配数据块" << std::endl;
         return false;
     }
+    root_inode.extent_count = 1;
+    root_inode.extents[0] = {0, root_inode.start_block, 1};
 
     // 写入inode
     if (!write_inode(ROOT_INODE_ID, &root_inode)) {
@@ -70,8 +215,11 @@ bool INodeManager::create_root_directory() {
     }
 
     // 标记inode为已使用
-    inode_used_[ROOT_INODE_ID] = true;
-    inode_count_++;
+    if (!claim_inode_slot(ROOT_INODE_ID)) {
+        std::cerr << "Error: 根目录inode已被占用" << std::endl;
+        bitmap_->free_consecutive_blocks(root_inode.start_block, 1);
+        return false;
+    }
 
     // 创建目录对象
     auto root_dir = std::make_unique<Directory>(ROOT_INODE_ID);
@@ -117,35 +265,35 @@ int32_t INodeManager::create_inode(const uint32_t parent_id, const uint8_t type,
         return -1; // 无可用 inode
     }
 
-    // 寻找未使用的 inode 槽位需要原子操作
-    int32_t inode_id = -1;
-    {
-        LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
-        for (uint32_t i = 1; i < max_inodes_; ++i) {
-            if (!inode_used_[i]) {
-                inode_id = i;
-                inode_used_[i] = true;  // 立即标记为已使用
-                break;
-            }
-        }
-    }
+    // 在inode位图中按字查找空闲槽位并立即标记为已使用
+    const int32_t inode_id = allocate_inode_slot();
     if (inode_id == -1) {
         std::cerr << "No free inodes available" << std::endl;
         return -1;
     }
 
-    // 分配连续块
+    // 分配连续块：以父目录数据块之后为目标，使同一目录下的文件聚集在一起
     uint32_t block_count = calculate_blocks_needed(size);
     uint32_t start_block = 0;
-
-    if (type == FS_FILE) {
-        if (!bitmap_->allocate_consecutive_blocks(block_count, start_block)) {
-            inode_used_[inode_id] = false; // 失败时回滚
+    uint32_t goal = UINT32_MAX;
+    INode parent;
+    std::vector<Extent> parent_extents;
+    if (read_inode(parent_id, &parent) && load_extents(parent, parent_extents) && !parent_extents.empty()) {
+        goal = parent_extents.back().start + parent_extents.back().count;
+    }
+
+    const bool inline_data = type == FS_FILE && size <= INODE_INLINE_DATA_MAX;
+    if (inline_data) {
+        // 小文件的数据直接放在inode中，不分配数据块
+        block_count = 0;
+    } else if (type == FS_FILE) {
+        if (!bitmap_->allocate_consecutive_blocks(block_count, start_block, goal)) {
+            release_inode_slot(inode_id); // 失败时回滚
             return -2;
         }
     } else {
-        if (!bitmap_->allocate_consecutive_blocks(1, start_block)) {
-            inode_used_[inode_id] = false; // 失败时回滚
+        if (!bitmap_->allocate_consecutive_blocks(1, start_block, goal)) {
+            release_inode_slot(inode_id); // 失败时回滚
             return -2;
         }
         block_count = 1;
@@ -163,10 +311,18 @@ int32_t INodeManager::create_inode(const uint32_t parent_id, const uint8_t type,
     };
     strncpy(new_node.name, name.c_str(), sizeof(new_node.name) - 1);
     new_node.name[sizeof(new_node.name) - 1] = '\0';
+    if (inline_data) {
+        new_node.flags = INODE_FLAG_INLINE;
+    } else {
+        new_node.extent_count = 1;
+        new_node.extents[0] = {0, start_block, block_count};
+    }
 
     if (!write_inode(new_node.id, &new_node)) {
-        bitmap_->free_consecutive_blocks(start_block, block_count);
-        inode_used_[inode_id] = false; // 写入失败，回滚
+        if (block_count > 0) {
+            bitmap_->free_consecutive_blocks(start_block, block_count);
+        }
+        release_inode_slot(inode_id); // 写入失败，回滚
         return -3;
     }
 
@@ -178,23 +334,34 @@ int32_t INodeManager::create_inode(const uint32_t parent_id, const uint8_t type,
         }
     }
 
-    inode_used_[inode_id] = true;
-    inode_count_++;
     return inode_id;
 }
 
-bool INodeManager::read_inode(const uint32_t inode_id, INode* node) const
+bool INodeManager::load_table_block_locked(const uint32_t table_block) const
 {
-    if (inode_id >= max_inodes_ || !inode_used_[inode_id]) return false;
-
-    const uint32_t block_index = inode_id / INODES_PER_BLOCK + inode_table_start_;
-    const uint32_t block_offset = (inode_id % INODES_PER_BLOCK) * INODE_SIZE;
+    if (table_block_loaded_[table_block]) return true;
 
+    // 整块读入后拆成inode，之后对本块的访问不再经过缓存
     std::vector<uint8_t> block_buffer(BLOCK_SIZE);
-    // 使用缓存读取
-    if (!cache_->read_block(block_index, block_buffer.data())) return false;
+    if (!cache_->read_block(inode_table_start_ + table_block, block_buffer.data(), CacheClass::METADATA)) {
+        return false;
+    }
+    const uint32_t first = table_block * INODES_PER_BLOCK;
+    const uint32_t last = std::min(first + INODES_PER_BLOCK, max_inodes_);
+    for (uint32_t id = first; id < last; ++id) {
+        memcpy(&inode_table_[id], block_buffer.data() + (id - first) * INODE_SIZE, INODE_SIZE);
+    }
+    table_block_loaded_[table_block] = true;
+    return true;
+}
 
-    memcpy(node, block_buffer.data() + block_offset, INODE_SIZE);
+bool INodeManager::read_inode(const uint32_t inode_id, INode* node) const
+{
+    if (inode_id >= max_inodes_ || !is_inode_used(inode_id)) return false;
+
+    LockGuard<SimpleMutex> lock(table_mutex_);
+    if (!load_table_block_locked(inode_id / INODES_PER_BLOCK)) return false;
+    *node = inode_table_[inode_id];
     return true;
 }
 
@@ -202,24 +369,46 @@ bool INodeManager::write_inode(const uint32_t inode_id, const INode* node) const
 {
     if (inode_id >= max_inodes_) return false;
 
-    const uint32_t block_index = inode_id / INODES_PER_BLOCK + inode_table_start_;
-    const uint32_t block_offset = (inode_id % INODES_PER_BLOCK) * INODE_SIZE;
+    // 先装入所在表块，写回时才能整块覆盖而不丢失同块的其他inode
+    LockGuard<SimpleMutex> lock(table_mutex_);
+    if (!load_table_block_locked(inode_id / INODES_PER_BLOCK)) return false;
+    inode_table_[inode_id] = *node;
+    inode_dirty_[inode_id] = true;
+    return true;
+}
 
+bool INodeManager::flush_inode_table() const
+{
+    LockGuard<SimpleMutex> lock(table_mutex_);
     std::vector<uint8_t> block_buffer(BLOCK_SIZE);
-    // 先读到缓存（如果不在的话），再修改，然后写回缓存
-    // read_block 会确保块数据在缓存中
-    if (!cache_->read_block(block_index, block_buffer.data())) {
-        // 如果inode表块不存在，可能需要特殊处理，但通常它应该已存在
-        // 这里假设它总能被读取
-    }
+    bool ok = true;
+    for (uint32_t table_block = 0; table_block < table_block_loaded_.size(); ++table_block) {
+        const uint32_t first = table_block * INODES_PER_BLOCK;
+        const uint32_t last = std::min(first + INODES_PER_BLOCK, max_inodes_);
+        bool dirty = false;
+        for (uint32_t id = first; id < last && !dirty; ++id) {
+            dirty = inode_dirty_[id];
+        }
+        if (!dirty) continue;
 
-    memcpy(block_buffer.data() + block_offset, node, INODE_SIZE);
-    // 写入操作会通过缓存，并标记为脏页
-    return cache_->write_block(block_index, block_buffer.data());
+        // 表块已在内存中完整存在，直接整块覆盖写，不需要读-改-写
+        std::fill(block_buffer.begin(), block_buffer.end(), 0);
+        for (uint32_t id = first; id < last; ++id) {
+            memcpy(block_buffer.data() + (id - first) * INODE_SIZE, &inode_table_[id], INODE_SIZE);
+        }
+        if (!cache_->write_block(inode_table_start_ + table_block, block_buffer.data(), CacheClass::METADATA)) {
+            ok = false;
+            continue;
+        }
+        for (uint32_t id = first; id < last; ++id) {
+            inode_dirty_[id] = false;
+        }
+    }
+    return ok;
 }
 
 bool INodeManager::delete_inode(const uint32_t inode_id) {
-    if (inode_id >= MAX_FILES || !inode_used_[inode_id]) return false;
+    if (inode_id >= MAX_FILES || !is_inode_used(inode_id)) return false;
 
     INode node;
     if (!read_inode(inode_id, &node)) return false;
@@ -229,8 +418,14 @@ bool INodeManager::delete_inode(const uint32_t inode_id) {
         remove_directory_entry(node.parent_id, node.name);
     }
 
-    if (node.block_count > 0) {
-        bitmap_->free_consecutive_blocks(node.start_block, node.block_count);
+    // 缓冲中尚未写回的数据直接丢弃
+    discard_pending(inode_id);
+
+    // 释放所有区段以及溢出区段块
+    std::vector<Extent> extents;
+    if (load_extents(node, extents)) {
+        free_extents(extents, 0);
+        store_extents(node, extents);
     }
 
     // 从缓存中移除
@@ -245,90 +440,561 @@ bool INodeManager::delete_inode(const uint32_t inode_id) {
     // if (!write_inode(inode_id, &node)) return false;
 
     // 原子性地更新使用状态
-    {
-        LockGuard<SimpleMutex> alloc_guard(allocation_mutex_);
-        inode_used_[inode_id] = false;
-        inode_count_--;
+    release_inode_slot(inode_id);
+
+    return true;
+}
+
+bool INodeManager::resize_inode(const uint32_t inode_id, const uint32_t new_size) const
+{
+    // 先写回缓冲数据，使inode的块信息与大小一致
+    if (!flush_pending(inode_id)) {
+        return false;
+    }
+    return resize_blocks(inode_id, new_size, false);
+}
+
+bool INodeManager::resize_blocks(const uint32_t inode_id, const uint32_t new_size, const bool reserve_growth) const
+{
+    if (inode_id >= MAX_FILES) return false;
+
+    if (!is_inode_used(inode_id)) return false;
+
+
+    INode node;
+    if (!read_inode(inode_id, &node)) return false;
+
+    // 至少保留一个块，空文件也不释放全部空间
+    const uint32_t new_blocks = std::max(calculate_blocks_needed(new_size), 1u);
+    std::vector<Extent> extents;
+    if (!is_inline(node) && !load_extents(node, extents)) {
+        return false;
+    }
+    const uint32_t old_blocks = mapped_end(extents);
+
+    if (is_inline(node) && new_size <= INODE_INLINE_DATA_MAX) {
+        // 内联文件仍放得下：只调整大小，截掉的部分清零
+        if (new_size < node.size) {
+            memset(node.inline_data + new_size, 0, std::min<uint32_t>(node.size, INODE_INLINE_DATA_MAX) - new_size);
+        }
+    } else if (new_blocks > old_blocks) {
+        // 追加式增长时额外预留一部分块，之后的追加直接落在预留区内，避免每次都搬迁整个文件
+        uint32_t target = new_blocks;
+        if (reserve_growth && node.type == FS_FILE) {
+            target += growth_reserve_blocks(new_blocks);
+        }
+        if (!extend_blocks(node, target) && (target == new_blocks || !extend_blocks(node, new_blocks))) {
+            return false;
+        }
+    } else if (new_size < node.size && new_blocks < old_blocks) {
+        // 缩小文件：从尾部区段开始原地释放（包括超出文件末尾的预分配块）
+        free_extents(extents, new_blocks);
+        if (!store_extents(node, extents)) {
+            return false;
+        }
+    }
+
+    node.size = new_size;
+    node.modify_time = time(nullptr);
+    return write_inode(inode_id, &node);
+}
+
+bool INodeManager::extend_blocks(INode& node, const uint32_t target_blocks) const
+{
+    if (is_inline(node)) {
+        return convert_inline(node, target_blocks);
+    }
+
+    std::vector<Extent> extents;
+    if (!load_extents(node, extents)) {
+        return false;
+    }
+    const uint32_t old_end = mapped_end(extents);
+    if (target_blocks <= old_end) {
+        return true;
+    }
+
+    // 在最后一个区段之后追加映射，已有数据不搬动
+    if (allocate_range(node, extents, old_end, target_blocks - old_end)) {
+        return true;
+    }
+
+    // 区段表已满（或空间过碎）：退回到整体搬迁成一个区段（尽量靠近原位置）
+    uint32_t new_start;
+    if (!bitmap_->allocate_consecutive_blocks(target_blocks, new_start, node.start_block)) {
+        return false;
+    }
+    return relocate_extents(node, extents, new_start, target_blocks);
+}
+
+bool INodeManager::allocate_range(INode& node, std::vector<Extent>& extents,
+                                  const uint32_t first, const uint32_t count) const
+{
+    const std::vector<Extent> original = extents;
+    std::vector<std::pair<uint32_t, uint32_t>> added;   // 本次新分配的块，失败时归还
+    const uint32_t end = first + count;
+    bool ok = true;
+
+    // 逐个填补 [first, end) 中未映射的空段；已映射的块保持不动
+    uint32_t logical = first;
+    while (ok && logical < end) {
+        // next 为第一个起点在logical之后的区段，前一个区段覆盖logical时跳过已映射部分
+        size_t next = std::upper_bound(extents.begin(), extents.end(), logical,
+                                       [](const uint32_t value, const Extent& extent) { return value < extent.logical; }) -
+                      extents.begin();
+        if (next > 0 && logical < extents[next - 1].logical + extents[next - 1].count) {
+            logical = extents[next - 1].logical + extents[next - 1].count;
+            continue;
+        }
+        const uint32_t gap_end = next < extents.size() ? std::min(end, extents[next].logical) : end;
+
+        // 以前一个区段的物理位置按逻辑距离推算目标，恰好相接时可以合并成一个区段；
+        // 找不到这么长的连续空间时折半申请，用多个区段凑齐
+        uint32_t goal = UINT32_MAX;
+        if (next > 0) {
+            const Extent& prev = extents[next - 1];
+            goal = prev.start + prev.count + (logical - prev.logical - prev.count);
+        } else if (next < extents.size() && extents[next].start >= extents[next].logical - logical) {
+            goal = extents[next].start - (extents[next].logical - logical);
+        }
+        uint32_t piece = gap_end - logical;
+        uint32_t start;
+        while (!bitmap_->allocate_consecutive_blocks(piece, start, goal)) {
+            if (piece == 1) {
+                ok = false;
+                break;
+            }
+            piece /= 2;
+        }
+        if (!ok) {
+            break;
+        }
+        added.emplace_back(start, piece);
+
+        // 插入新区段，与物理上也相接的前后区段合并
+        if (next > 0 && extents[next - 1].logical + extents[next - 1].count == logical &&
+            extents[next - 1].start + extents[next - 1].count == start) {
+            extents[next - 1].count += piece;
+        } else {
+            extents.insert(extents.begin() + next, Extent{logical, start, piece});
+            ++next;
+        }
+        Extent& merged = extents[next - 1];
+        if (next < extents.size() && merged.logical + merged.count == extents[next].logical &&
+            merged.start + merged.count == extents[next].start) {
+            merged.count += extents[next].count;
+            extents.erase(extents.begin() + next);
+        }
+        logical += piece;
+    }
+
+    if (ok && extents.size() <= INODE_MAX_EXTENTS && store_extents(node, extents)) {
+        return true;
+    }
+
+    for (const auto& [start, blocks] : added) {
+        bitmap_->free_consecutive_blocks(start, blocks);
+    }
+    extents = original;
+    return false;
+}
+
+bool INodeManager::convert_inline(INode& node, const uint32_t target_blocks) const
+{
+    // 内联数据放不下了：分配数据块，把已有内容搬到第一个块
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE, 0);
+    memcpy(block_buffer.data(), node.inline_data, std::min<uint32_t>(node.size, INODE_INLINE_DATA_MAX));
+
+    INode converted = node;
+    converted.flags &= ~INODE_FLAG_INLINE;
+    memset(converted.inline_data, 0, sizeof(converted.inline_data));
+    if (!extend_blocks(converted, node.size > 0 ? std::max(target_blocks, 1u) : target_blocks)) {
+        return false;
+    }
+
+    if (node.size > 0 && !cache_->write_block(converted.start_block, block_buffer.data(), cache_class_of(converted))) {
+        std::vector<Extent> extents;
+        if (load_extents(converted, extents)) {
+            free_extents(extents, 0);
+            store_extents(converted, extents);
+        }
+        return false;
+    }
+    node = converted;
+    return true;
+}
+
+bool INodeManager::is_inline(const INode& node)
+{
+    return (node.flags & INODE_FLAG_INLINE) != 0;
+}
+
+bool INodeManager::relocate_extents(INode& node, std::vector<Extent>& extents,
+                                    const uint32_t new_start, const uint32_t target_blocks) const
+{
+    // 把数据复制到已分配好的 [new_start, new_start + target_blocks)，成功后释放原来的区段
+    if (!copy_data_blocks(node, extents, new_start, target_blocks)) {
+        bitmap_->free_consecutive_blocks(new_start, target_blocks); // 清理
+        return false;
+    }
+
+    // 只剩一个区段，store_extents 不需要分配溢出块，不会失败
+    std::vector<Extent> old_extents = {Extent{0, new_start, target_blocks}};
+    extents.swap(old_extents);
+    store_extents(node, extents);
+    free_extents(old_extents, 0);
+    return true;
+}
+
+bool INodeManager::copy_data_blocks(const INode& node, const std::vector<Extent>& extents,
+                                    const uint32_t new_start, const uint32_t new_count) const
+{
+    // **[修复]** 移除直接的disk->copy_blocks调用，总是使用缓存来复制数据块
+    // 只复制存有数据的块，预分配的块没有内容；空洞在新位置写0
+    const uint32_t data_blocks = std::min(calculate_blocks_needed(node.size), new_count);
+    const CacheClass cls = cache_class_of(node);
+    std::vector<uint8_t> buffer(BLOCK_SIZE);
+    for (uint32_t logical = 0; logical < data_blocks; ++logical) {
+        const uint32_t block_no = map_block(extents, logical);
+        if (block_no == UINT32_MAX) {
+            std::fill(buffer.begin(), buffer.end(), 0);
+        } else if (!cache_->read_block(block_no, buffer.data(), cls)) {
+            return false;
+        }
+        if (!cache_->write_block(new_start + logical, buffer.data(), cls)) {
+            return false;
+        }
+    }
+    return true;
+}
+
+bool INodeManager::load_extents(const INode& node, std::vector<Extent>& extents) const
+{
+    const uint32_t inline_count = std::min<uint32_t>(node.extent_count, INODE_INLINE_EXTENTS);
+    extents.assign(node.extents, node.extents + inline_count);
+    if (node.extent_count <= INODE_INLINE_EXTENTS) {
+        return true;
+    }
+
+    if (node.overflow_block == 0 || node.extent_count > INODE_MAX_EXTENTS) {
+        std::cerr << "Error: inode " << node.id << " 的区段表损坏" << std::endl;
+        return false;
+    }
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    if (!cache_->read_block(node.overflow_block, block_buffer.data(), CacheClass::METADATA)) {
+        return false;
+    }
+    const auto* overflow = reinterpret_cast<const Extent*>(block_buffer.data());
+    extents.insert(extents.end(), overflow, overflow + (node.extent_count - INODE_INLINE_EXTENTS));
+    return true;
+}
+
+bool INodeManager::store_extents(INode& node, const std::vector<Extent>& extents) const
+{
+    if (extents.size() > INODE_MAX_EXTENTS) {
+        return false;
+    }
+
+    // 超出inode容量的区段写入溢出块（需要时才分配），区段减少后归还溢出块
+    uint32_t overflow_block = node.overflow_block;
+    if (extents.size() > INODE_INLINE_EXTENTS) {
+        if (overflow_block == 0 &&
+            !bitmap_->allocate_consecutive_blocks(1, overflow_block, extents.back().start + extents.back().count)) {
+            return false;
+        }
+        std::vector<uint8_t> block_buffer(BLOCK_SIZE, 0);
+        memcpy(block_buffer.data(), extents.data() + INODE_INLINE_EXTENTS,
+               (extents.size() - INODE_INLINE_EXTENTS) * sizeof(Extent));
+        if (!cache_->write_block(overflow_block, block_buffer.data(), CacheClass::METADATA)) {
+            if (node.overflow_block == 0) {
+                bitmap_->free_consecutive_blocks(overflow_block, 1);
+            }
+            return false;
+        }
+    } else if (overflow_block != 0) {
+        bitmap_->free_consecutive_blocks(overflow_block, 1);
+        overflow_block = 0;
+    }
+
+    node.overflow_block = overflow_block;
+    node.extent_count = extents.size();
+    memset(node.extents, 0, sizeof(node.extents));
+    std::copy_n(extents.begin(), std::min<size_t>(extents.size(), INODE_INLINE_EXTENTS), node.extents);
+    node.start_block = extents.empty() ? 0 : extents.front().start;
+    node.block_count = 0;
+    for (const Extent& extent : extents) {
+        node.block_count += extent.count;
+    }
+    return true;
+}
+
+void INodeManager::free_extents(std::vector<Extent>& extents, const uint32_t keep_blocks) const
+{
+    // 从最后一个区段往前释放文件内序号不小于keep_blocks的块
+    while (!extents.empty()) {
+        Extent& last = extents.back();
+        if (last.logical >= keep_blocks) {
+            bitmap_->free_consecutive_blocks(last.start, last.count);
+            extents.pop_back();
+            continue;
+        }
+        if (last.logical + last.count > keep_blocks) {
+            const uint32_t dropped = last.logical + last.count - keep_blocks;
+            bitmap_->free_consecutive_blocks(last.start + last.count - dropped, dropped);
+            last.count -= dropped;
+        }
+        break;
+    }
+}
+
+uint32_t INodeManager::mapped_end(const std::vector<Extent>& extents)
+{
+    return extents.empty() ? 0 : extents.back().logical + extents.back().count;
+}
+
+bool INodeManager::is_sparse(const std::vector<Extent>& extents)
+{
+    uint32_t expected = 0;
+    for (const Extent& extent : extents) {
+        if (extent.logical != expected) {
+            return true;
+        }
+        expected += extent.count;
+    }
+    return false;
+}
+
+uint32_t INodeManager::map_block(const std::vector<Extent>& extents, const uint32_t logical)
+{
+    // 区段按logical升序排列，二分查找最后一个起点不大于logical的区段
+    const auto it = std::upper_bound(extents.begin(), extents.end(), logical,
+                                     [](const uint32_t value, const Extent& extent) { return value < extent.logical; });
+    if (it == extents.begin()) {
+        return UINT32_MAX;
+    }
+    const Extent& extent = *std::prev(it);
+    return logical - extent.logical < extent.count ? extent.start + (logical - extent.logical) : UINT32_MAX;
+}
+
+bool INodeManager::relocate_lower(const uint32_t inode_id, uint32_t& moved_blocks) const
+{
+    moved_blocks = 0;
+    INode node;
+    std::vector<Extent> extents;
+    if (!is_inode_used(inode_id) || !read_inode(inode_id, &node) || node.block_count == 0 ||
+        !load_extents(node, extents)) {
+        return false;
+    }
+
+    // 稀疏文件整理成连续区段会把空洞变成实际占用的块，不做处理
+    if (is_sparse(extents)) {
+        return false;
+    }
+
+    // 从数据区开头找第一个放得下的空闲区段；单区段文件只有能更靠前时才搬迁，多区段文件总是合并成一个区段
+    uint32_t new_start;
+    if (!bitmap_->allocate_consecutive_blocks(node.block_count, new_start, bitmap_->get_first_data_block())) {
+        return false;
+    }
+    if (extents.size() <= 1 && new_start >= node.start_block) {
+        bitmap_->free_consecutive_blocks(new_start, node.block_count);
+        return false;
+    }
+
+    if (!relocate_extents(node, extents, new_start, node.block_count)) {
+        return false;
+    }
+    if (!write_inode(inode_id, &node)) {
+        return false;
+    }
+    moved_blocks = std::min(calculate_blocks_needed(node.size), node.block_count);
+    return true;
+}
+
+DefragStats INodeManager::defragment(const uint32_t blocks_per_second, const uint32_t max_moves) const
+{
+    DefragStats stats;
+
+    // 延迟分配的数据先落盘，整理只处理已有物理位置的文件
+    flush_all_pending();
+
+    // 按起始块从低到高处理，逐个把文件挪向数据区开头，空闲空间随之向尾部合并
+    std::vector<std::pair<uint32_t, uint32_t>> order;   // (起始块, inode号)
+    for (uint32_t id = 1; id < max_inodes_; ++id) {
+        INode node;
+        if (is_inode_used(id) && read_inode(id, &node) && node.block_count > 0) {
+            order.emplace_back(node.start_block, id);
+        }
+    }
+    std::sort(order.begin(), order.end());
+
+    const auto started = std::chrono::steady_clock::now();
+    for (const auto& entry : order) {
+        if (stats.files_moved >= max_moves) {
+            break;
+        }
+        ++stats.files_scanned;
+
+        // 每次只搬一个文件，期间挡住延迟写入与写回
+        uint32_t moved = 0;
+        {
+            LockGuard<SimpleMutex> lock(pending_mutex_);
+            if (!relocate_lower(entry.second, moved)) {
+                continue;
+            }
+        }
+        ++stats.files_moved;
+        stats.blocks_moved += moved;
+
+        // 限速：复制速度超出配额时休眠，让前台I/O有机会执行
+        if (blocks_per_second > 0) {
+            const auto budget = std::chrono::duration<double>(static_cast<double>(stats.blocks_moved) / blocks_per_second);
+            const auto elapsed = std::chrono::steady_clock::now() - started;
+            if (budget > elapsed) {
+                std::this_thread::sleep_for(budget - elapsed);
+            }
+        }
+    }
+    return stats;
+}
+
+bool INodeManager::preallocate(const std::string& path, const uint32_t length) const
+{
+    const int32_t inode_id = resolve_path(path);
+    if (inode_id == -1) {
+        return false;
+    }
+    return preallocate_inode(inode_id, length);
+}
+
+bool INodeManager::preallocate_inode(const uint32_t inode_id, const uint32_t length) const
+{
+    // 先写回缓冲数据，预分配在最终的块位置上进行
+    if (!flush_pending(inode_id)) {
+        return false;
+    }
+
+    INode node;
+    if (!read_inode(inode_id, &node) || node.type != FS_FILE) {
+        return false;
+    }
+
+    // 内联文件在上限以内无需预分配
+    if (is_inline(node) && length <= INODE_INLINE_DATA_MAX) {
+        return true;
+    }
+
+    // 只增加块数，文件大小保持不变
+    const uint32_t blocks = calculate_blocks_needed(length);
+    if (length > INODE_MAX_FILE_SIZE || blocks > bitmap_->get_total_blocks()) {
+        std::cerr << "预分配长度超出磁盘容量: " << length << " 字节" << std::endl;
+        return false;
+    }
+    if (is_inline(node)) {
+        return extend_blocks(node, blocks) && write_inode(inode_id, &node);
+    }
+
+    // 范围内的空洞也一并分配；落在文件末尾之前的新块清零，保证仍读出0
+    std::vector<Extent> extents;
+    if (!load_extents(node, extents)) {
+        return false;
+    }
+    const std::vector<Extent> before = extents;
+    const uint32_t data_blocks = std::min(blocks, calculate_blocks_needed(node.size));
+    if (!allocate_range(node, extents, 0, blocks)) {
+        // 区段表已满时只有没有空洞的文件可以整体搬迁
+        if (is_sparse(before) || mapped_end(before) < data_blocks || !extend_blocks(node, blocks)) {
+            return false;
+        }
+        return write_inode(inode_id, &node);
+    }
+    const CacheClass cls = cache_class_of(node);
+    const std::vector<uint8_t> zero_block(BLOCK_SIZE, 0);
+    for (uint32_t block_index = 0; block_index < data_blocks; ++block_index) {
+        if (map_block(before, block_index) == UINT32_MAX &&
+            !cache_->write_block(map_block(extents, block_index), zero_block.data(), cls)) {
+            return false;
+        }
+    }
+    return write_inode(inode_id, &node);
+}
+
+bool INodeManager::truncate(const std::string& path, const uint32_t size) const
+{
+    const int32_t inode_id = resolve_path(path);
+    if (inode_id == -1) {
+        return false;
     }
-
-    return true;
+    return truncate_inode(inode_id, size);
 }
 
-bool INodeManager::resize_inode(const uint32_t inode_id, const uint32_t new_size) const
+bool INodeManager::truncate_inode(const uint32_t inode_id, const uint32_t size) const
 {
-    if (inode_id >= MAX_FILES) return false;
-
-    if (!inode_used_[inode_id]) return false;
-
-
-    INode node;
-    if (!read_inode(inode_id, &node)) return false;
-
-    const uint32_t new_blocks = calculate_blocks_needed(new_size);
-    const uint32_t old_blocks = node.block_count;
-
-    if (new_blocks == old_blocks) {
-        node.size = new_size;
-        node.modify_time = time(nullptr);
-        return write_inode(inode_id, &node);
+    if (size > INODE_MAX_FILE_SIZE) {
+        std::cerr << "文件大小超出上限: " << size << " 字节" << std::endl;
+        return false;
     }
 
-    if (new_blocks > old_blocks) {
-        const uint32_t additional = new_blocks - old_blocks;
-        bool contiguous = true;
-
-        // 检查后续 block 是否空闲（确保从 node.start_block + old_blocks 开始有足够空位）
-        for (uint32_t i = 0; i < additional; ++i) {
-            if (bitmap_->is_block_allocated(node.start_block + old_blocks + i)) {
-                contiguous = false;
-                break;
-            }
-        }
-
-        if (contiguous) {
-            // 直接手动标记新块为已使用
-            for (uint32_t i = 0; i < additional; ++i) {
-                bitmap_->mark_block_used(node.start_block + old_blocks + i); // 你需要在 FreeBitmap 里实现这个函数
-            }
-
-            node.block_count = new_blocks;
-            node.size = new_size;
-            node.modify_time = time(nullptr);
-            return write_inode(inode_id, &node);
-        }
+    // 先写回缓冲数据，截断作用在最终的块映射上
+    if (!flush_pending(inode_id)) {
+        return false;
     }
 
-    // 不连续，重新分配块
-    uint32_t new_start;
-    if (!bitmap_->allocate_consecutive_blocks(new_blocks, new_start)) {
+    INode node;
+    if (!read_inode(inode_id, &node) || node.type != FS_FILE) {
         return false;
     }
+    const uint32_t old_size = node.size;
 
-    // **[修复]** 移除直接的disk->copy_blocks调用，总是使用缓存来复制数据块
-    std::vector<uint8_t> buffer(BLOCK_SIZE);
-    for(uint32_t i = 0; i < old_blocks; ++i) {
-        if (!cache_->read_block(node.start_block + i, buffer.data())) {
-            bitmap_->free_consecutive_blocks(new_start, new_blocks); // 清理
+    if (is_inline(node) && size <= INODE_INLINE_DATA_MAX) {
+        // 内联数据：截掉的部分清零，扩大时尾部本来就是0
+        if (size < old_size) {
+            memset(node.inline_data + size, 0, old_size - size);
+        }
+    } else {
+        // 扩大到内联上限之外时转为块存储，新增的部分是空洞，不分配块
+        if (is_inline(node) && !convert_inline(node, calculate_blocks_needed(old_size))) {
+            return false;
+        }
+        std::vector<Extent> extents;
+        if (!load_extents(node, extents)) {
             return false;
         }
-        if (!cache_->write_block(new_start + i, buffer.data())) {
-            bitmap_->free_consecutive_blocks(new_start, new_blocks); // 清理
+
+        if (size < old_size) {
+            // 释放新末尾之后的所有块（包括预分配块），不读写其中的数据；
+            // 末尾所在块中截掉的部分清零，以后再扩大时读出的是0
+            free_extents(extents, calculate_blocks_needed(size));
+            if (!store_extents(node, extents) ||
+                !zero_range(node, extents, size, std::min(old_size, calculate_blocks_needed(size) * BLOCK_SIZE))) {
+                return false;
+            }
+        } else if (!zero_range(node, extents, old_size, size)) {
+            // 扩大：原末尾之后已分配的块（预分配空间）清零
             return false;
         }
     }
 
-    bitmap_->free_consecutive_blocks(node.start_block, old_blocks);
-    node.start_block = new_start;
-    node.block_count = new_blocks;
-    node.size = new_size;
+    node.size = size;
     node.modify_time = time(nullptr);
-
     return write_inode(inode_id, &node);
 }
 
+uint32_t INodeManager::growth_reserve_blocks(const uint32_t blocks)
+{
+    return std::max(blocks * INODE_GROWTH_RESERVE_PERCENT / 100, 1u);
+}
+
+// 目录块属于元数据，其余为普通数据
+CacheClass INodeManager::cache_class_of(const INode& node)
+{
+    return node.type == FS_DIRECTORY ? CacheClass::METADATA : CacheClass::DATA;
+}
+
 uint32_t INodeManager::calculate_blocks_needed(const uint32_t size)
 {
-    return (size + BLOCK_SIZE - 1) / BLOCK_SIZE;
+    // 按64位计算，接近 UINT32_MAX 的大小不会回绕成0块
+    return static_cast<uint32_t>((static_cast<uint64_t>(size) + BLOCK_SIZE - 1) / BLOCK_SIZE);
 }
 
 int32_t INodeManager::find_inode(const uint32_t parent_id, const std::string& name) const
@@ -399,16 +1065,15 @@ bool INodeManager::create_file(const std::string& normalized, const std::string&
         return false;
     }
 
-    // 创建文件inode
-    const size_t file_size = content.size() == 0 ? 1 : content.size();
-    const int32_t file_inode = create_inode(parent_inode, FS_FILE, filename, file_size);
+    // 创建文件inode：先以内联方式创建，内容按延迟分配写入，超出内联上限时写回再分配数据块
+    const int32_t file_inode = create_inode(parent_inode, FS_FILE, filename, 0);
     if (file_inode == -1) {
         return false;
     }
 
     // 写入文件内容
     if (!content.empty()) {
-        return write_file_data(file_inode, content);
+        return write_delayed(file_inode, content, false);
     }
 
     return true;
@@ -485,12 +1150,33 @@ bool INodeManager::write_file(const std::string& path, const std::string& conten
         return false;
     }
 
-    // 调整文件大小
-    if (!resize_inode(inode_id, content.size())) {
+    // 大小调整推迟到写回时进行
+    return write_file_data(inode_id, content);
+}
+
+bool INodeManager::read_at(const std::string& path, const uint32_t offset, const uint32_t length, std::string& content) const
+{
+    const int32_t inode_id = resolve_path(path);
+    if (inode_id == -1) {
+        return false;
+    }
+
+    content.resize(length);
+    uint32_t bytes_read = 0;
+    if (!read_at(inode_id, offset, content.data(), length, bytes_read)) {
         return false;
     }
+    content.resize(bytes_read);
+    return true;
+}
 
-    return write_file_data(inode_id, content);
+bool INodeManager::write_at(const std::string& path, const uint32_t offset, const std::string& data) const
+{
+    const int32_t inode_id = resolve_path(path);
+    if (inode_id == -1) {
+        return false;
+    }
+    return write_at(inode_id, offset, data.data(), data.size());
 }
 
 std::vector<FileInfo> INodeManager::list_directory(const std::string& normalized) const
@@ -520,6 +1206,8 @@ std::vector<FileInfo> INodeManager::list_directory(const std::string& normalized
             info.modify_time = inode.modify_time;
             info.block_count = inode.block_count;
             info.start_block = inode.start_block;
+            info.extent_count = inode.extent_count;
+            info.inline_data = is_inline(inode);
             info.inode_id = inode.id;
             result.push_back(info);
         }
@@ -550,6 +1238,8 @@ FileInfo INodeManager::get_file_info(const std::string& path) const
     info.modify_time = inode.modify_time;
     info.block_count = inode.block_count;
     info.start_block = inode.start_block;
+    info.extent_count = inode.extent_count;
+    info.inline_data = is_inline(inode);
     info.inode_id = inode.id;
 
     return info;
@@ -717,70 +1407,314 @@ bool INodeManager::delete_directory(const std::string& path) {
 }
 
 bool INodeManager::read_inode_data(const uint32_t inode_id, std::string& content) const
+{
+    // 尚未写回的数据直接从缓冲读取
+    {
+        LockGuard<SimpleMutex> lock(pending_mutex_);
+        const auto it = pending_writes_.find(inode_id);
+        if (it != pending_writes_.end()) {
+            content = it->second.data;
+            return true;
+        }
+    }
+
+    // 逐块从缓存页直接追加到结果中，不再经过中间缓冲区
+    FileReader reader(this, cache_, inode_id);
+    if (!reader.is_open()) {
+        return false;
+    }
+    content.clear();
+    content.reserve(reader.size());
+    const char* data;
+    size_t length;
+    while (reader.next(data, length)) {
+        content.append(data, length);
+    }
+    return !reader.failed();
+}
+
+bool INodeManager::get_layout(const uint32_t inode_id, INode& node, std::vector<Extent>& extents) const
+{
+    if (!flush_pending(inode_id) || !is_inode_used(inode_id) || !read_inode(inode_id, &node)) {
+        return false;
+    }
+    extents.clear();
+    return is_inline(node) || load_extents(node, extents);
+}
+
+bool INodeManager::write_inode_data(const uint32_t inode_id, const std::string& content, const bool reserve_growth) const
 {
     INode inode;
     if (!read_inode(inode_id, &inode)) {
         return false;
     }
 
-    // 使用vector作为中间缓冲区
-    std::vector<uint8_t> buffer(inode.size);
-    for (uint32_t i = 0; i < inode.block_count; ++i) {
-        const size_t offset = i * BLOCK_SIZE;
-        const size_t copy_size = std::min(static_cast<size_t>(BLOCK_SIZE), inode.size - offset);
+    // 内联文件仍放得下时直接写进inode
+    if (is_inline(inode) && content.size() <= INODE_INLINE_DATA_MAX) {
+        memset(inode.inline_data, 0, sizeof(inode.inline_data));
+        memcpy(inode.inline_data, content.data(), content.size());
+        inode.size = content.size();
+        inode.modify_time = time(nullptr);
+        return write_inode(inode_id, &inode);
+    }
 
-        std::vector<uint8_t> block_buffer(BLOCK_SIZE);
-        // 使用缓存读取
-        if (!cache_->read_block(inode.start_block + i, block_buffer.data())) {
+    // 延迟分配的文件在写入时已更新大小，块数可能仍不够；多出的块是预分配空间，保留不动
+    const uint32_t data_blocks = calculate_blocks_needed(content.size());
+    if (inode.size != content.size() || inode.block_count < data_blocks) {
+        if (!resize_blocks(inode_id, content.size(), reserve_growth)) {
             return false;
         }
-        if (copy_size > 0) {
-            std::memcpy(buffer.data() + offset, block_buffer.data(), copy_size);
+        // 重新读取调整大小后的inode
+        if (!read_inode(inode_id, &inode)) {
+            return false;
         }
     }
 
-    content.assign(buffer.begin(), buffer.end());
-    return true;
+    // 整体写入时内容覆盖每一块，空洞也要分配
+    std::vector<Extent> extents;
+    if (!load_extents(inode, extents) || !allocate_range(inode, extents, 0, data_blocks)) {
+        return false;
+    }
+
+    // 按区段写入所有数据块（不含预分配的块）
+    const CacheClass cls = cache_class_of(inode);
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    for (const Extent& extent : extents) {
+        for (uint32_t i = 0; i < extent.count && extent.logical + i < data_blocks; ++i) {
+            const size_t offset = static_cast<size_t>(extent.logical + i) * BLOCK_SIZE;
+            const size_t copy_size = std::min(static_cast<size_t>(BLOCK_SIZE), content.size() - offset);
+
+            std::fill(block_buffer.begin(), block_buffer.end(), 0);
+            if (copy_size > 0) {
+                memcpy(block_buffer.data(), content.data() + offset, copy_size);
+            }
+
+            // 使用缓存写入
+            if (!cache_->write_block(extent.start + i, block_buffer.data(), cls)) {
+                return false;
+            }
+        }
+    }
+
+    // 更新修改时间
+    inode.modify_time = time(nullptr);
+    return write_inode(inode_id, &inode);
+}
+
+bool INodeManager::append(const std::string& path, const std::string& data) const
+{
+    const int32_t inode_id = resolve_path(path);
+    if (inode_id == -1) {
+        return false;
+    }
+    return append(inode_id, data.data(), data.size());
 }
 
-bool INodeManager::write_inode_data(const uint32_t inode_id, const std::string& content) const
+bool INodeManager::append(const uint32_t inode_id, const char* data, const uint32_t length) const
 {
+    // 先写回缓冲数据，文件大小才是最终的追加位置
+    if (!flush_pending(inode_id)) {
+        return false;
+    }
+
     INode inode;
-    if (!read_inode(inode_id, &inode)) {
+    if (!read_inode(inode_id, &inode) || inode.type != FS_FILE) {
         return false;
     }
+    return write_at(inode_id, inode.size, data, length);
+}
 
-    if (inode.size != content.size()) {
-        if (!resize_inode(inode_id, content.size())) {
-            return false;
+bool INodeManager::read_at(const uint32_t inode_id, const uint32_t offset, char* buffer,
+                           const uint32_t length, uint32_t& bytes_read) const
+{
+    bytes_read = 0;
+
+    // 尚未写回的数据直接从缓冲读取
+    {
+        LockGuard<SimpleMutex> lock(pending_mutex_);
+        const auto it = pending_writes_.find(inode_id);
+        if (it != pending_writes_.end()) {
+            const std::string& data = it->second.data;
+            if (offset < data.size()) {
+                bytes_read = std::min<size_t>(length, data.size() - offset);
+                memcpy(buffer, data.data() + offset, bytes_read);
+            }
+            return true;
         }
-        // 重新读取调整大小后的inode
-        if (!read_inode(inode_id, &inode)) {
+    }
+
+    INode inode;
+    if (!read_inode(inode_id, &inode) || inode.type != FS_FILE) {
+        return false;
+    }
+    if (offset >= inode.size || length == 0) {
+        return true;
+    }
+    const uint32_t end = offset + std::min(length, inode.size - offset);
+
+    if (is_inline(inode)) {
+        bytes_read = std::min<uint32_t>(end, INODE_INLINE_DATA_MAX) - std::min<uint32_t>(offset, INODE_INLINE_DATA_MAX);
+        memcpy(buffer, inode.inline_data + offset, bytes_read);
+        return true;
+    }
+
+    std::vector<Extent> extents;
+    if (!load_extents(inode, extents)) {
+        return false;
+    }
+
+    // 只读取 [offset, end) 覆盖的块
+    const CacheClass cls = cache_class_of(inode);
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    for (uint32_t pos = offset; pos < end;) {
+        const uint32_t block_index = pos / BLOCK_SIZE;
+        const uint32_t in_block = pos % BLOCK_SIZE;
+        const uint32_t chunk = std::min(BLOCK_SIZE - in_block, end - pos);
+
+        // 空洞读出为0
+        const uint32_t block_no = map_block(extents, block_index);
+        if (block_no == UINT32_MAX) {
+            memset(buffer + (pos - offset), 0, chunk);
+        } else if (!cache_->read_block(block_no, block_buffer.data(), cls)) {
             return false;
+        } else {
+            memcpy(buffer + (pos - offset), block_buffer.data() + in_block, chunk);
         }
+        pos += chunk;
     }
+    bytes_read = end - offset;
+    return true;
+}
 
-    // 写入所有数据块
-    for (uint32_t i = 0; i < inode.block_count; ++i) {
-        const size_t offset = i * BLOCK_SIZE;
-        const size_t copy_size = std::min(static_cast<size_t>(BLOCK_SIZE), content.size() - offset);
+bool INodeManager::write_at(const uint32_t inode_id, const uint32_t offset, const char* data, const uint32_t length) const
+{
+    // 写入后的大小不能超过上限，否则按块计算会越过 uint32_t
+    if (length > INODE_MAX_FILE_SIZE || offset > INODE_MAX_FILE_SIZE - length) {
+        return false;
+    }
 
-        std::vector<uint8_t> block_buffer(BLOCK_SIZE, 0);
-        if (copy_size > 0) {
-            memcpy(block_buffer.data(), content.data() + offset, copy_size);
+    // 缓冲数据先写回，之后只改动涉及的块
+    if (!flush_pending(inode_id)) {
+        return false;
+    }
+
+    INode inode;
+    if (!read_inode(inode_id, &inode) || inode.type != FS_FILE) {
+        return false;
+    }
+    if (length == 0) {
+        return true;
+    }
+
+    const uint32_t old_size = inode.size;
+    const uint32_t end = offset + length;
+
+    // 内联文件写入后仍放得下时直接改inode（尾部始终保持为0，空洞自然读出0）
+    if (is_inline(inode) && end <= INODE_INLINE_DATA_MAX) {
+        memcpy(inode.inline_data + offset, data, length);
+        inode.size = std::max(old_size, end);
+        inode.modify_time = time(nullptr);
+        return write_inode(inode_id, &inode);
+    }
+
+    // 放不下的内联文件先把已有内容转到数据块
+    if (is_inline(inode) && !convert_inline(inode, calculate_blocks_needed(old_size))) {
+        return false;
+    }
+
+    std::vector<Extent> extents;
+    if (!load_extents(inode, extents)) {
+        return false;
+    }
+
+    // 写入起点在旧文件末尾之后时，中间已分配的块（预分配空间）清零，未分配的部分保持为空洞
+    if (offset > old_size && !zero_range(inode, extents, old_size, offset)) {
+        return false;
+    }
+
+    // 只为写入范围内的空洞分配块；紧接着已映射末尾、且越过文件末尾的增长写附带预留增长空间
+    // （预留的块都在新的文件末尾之后，不会把文件内的空洞变成未初始化的块）
+    const uint32_t first_block = offset / BLOCK_SIZE;
+    const uint32_t last_block = (end - 1) / BLOCK_SIZE;
+    const std::vector<Extent> before = extents;
+    const uint32_t old_end = mapped_end(extents);
+    const uint32_t needed = last_block + 1 - first_block;
+    const bool growing = end > old_size && first_block <= old_end && last_block + 1 > old_end;
+    const uint32_t reserve = growing ? growth_reserve_blocks(last_block + 1) : 0;
+    if (!allocate_range(inode, extents, first_block, needed + reserve) &&
+        (reserve == 0 || !allocate_range(inode, extents, first_block, needed))) {
+        return false;
+    }
+
+    const CacheClass cls = cache_class_of(inode);
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    for (uint32_t block_index = first_block; block_index <= last_block; ++block_index) {
+        const uint32_t block_start = block_index * BLOCK_SIZE;
+        const uint32_t block_end = block_start + BLOCK_SIZE;
+        const uint32_t block_no = map_block(extents, block_index);
+        if (block_no == UINT32_MAX) {
+            return false;
         }
 
-        // 使用缓存写入
-        if (!cache_->write_block(inode.start_block + i, block_buffer.data())) {
+        // 整块被覆盖、块在旧文件末尾之后或刚为空洞分配时不需要读出旧内容
+        const bool fully_covered = offset <= block_start && end >= block_end;
+        const bool was_hole = map_block(before, block_index) == UINT32_MAX;
+        if (fully_covered || block_start >= old_size || was_hole) {
+            std::fill(block_buffer.begin(), block_buffer.end(), 0);
+        } else {
+            if (!cache_->read_block(block_no, block_buffer.data(), cls)) {
+                return false;
+            }
+            // 旧文件末尾之后的残留内容清零
+            if (old_size < block_end) {
+                std::fill(block_buffer.begin() + (old_size - block_start), block_buffer.end(), 0);
+            }
+        }
+
+        const uint32_t copy_start = std::max(offset, block_start);
+        const uint32_t copy_end = std::min(end, block_end);
+        memcpy(block_buffer.data() + (copy_start - block_start), data + (copy_start - offset), copy_end - copy_start);
+        if (!cache_->write_block(block_no, block_buffer.data(), cls)) {
             return false;
         }
     }
 
-    // 更新修改时间
+    inode.size = std::max(old_size, end);
     inode.modify_time = time(nullptr);
     return write_inode(inode_id, &inode);
 }
 
+bool INodeManager::zero_range(const INode& node, const std::vector<Extent>& extents,
+                              const uint32_t from, const uint32_t to) const
+{
+    const CacheClass cls = cache_class_of(node);
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    for (uint32_t pos = from; pos < to;) {
+        const uint32_t block_index = pos / BLOCK_SIZE;
+        const uint32_t in_block = pos % BLOCK_SIZE;
+        const uint32_t chunk = std::min(BLOCK_SIZE - in_block, to - pos);
+        const uint32_t block_no = map_block(extents, block_index);
+        pos += chunk;
+        if (block_no == UINT32_MAX) {
+            continue;
+        }
+
+        // 整块清零直接覆盖，部分清零先读出再修改
+        if (chunk == BLOCK_SIZE) {
+            std::fill(block_buffer.begin(), block_buffer.end(), 0);
+        } else {
+            if (!cache_->read_block(block_no, block_buffer.data(), cls)) {
+                return false;
+            }
+            std::fill(block_buffer.begin() + in_block, block_buffer.begin() + in_block + chunk, 0);
+        }
+        if (!cache_->write_block(block_no, block_buffer.data(), cls)) {
+            return false;
+        }
+    }
+    return true;
+}
+
 bool INodeManager::read_file_data(const uint32_t inode_id, std::string& content) const
 {
     INode inode;
@@ -796,7 +1730,115 @@ bool INodeManager::write_file_data(const uint32_t inode_id, const std::string& c
     if (!read_inode(inode_id, &inode) || inode.type != FS_FILE) {
         return false;
     }
-    return write_inode_data(inode_id, content);
+    return write_delayed(inode_id, content, true);
+}
+
+bool INodeManager::write_delayed(const uint32_t inode_id, const std::string& content, const bool reserve_growth) const
+{
+    INode inode;
+    if (!read_inode(inode_id, &inode)) {
+        return false;
+    }
+
+    LockGuard<SimpleMutex> lock(pending_mutex_);
+
+    // 内联文件写入的只是inode本身，没有块需要延迟分配
+    if (is_inline(inode) && content.size() <= INODE_INLINE_DATA_MAX) {
+        drop_pending_locked(inode_id);
+        return write_inode_data(inode_id, content, false);
+    }
+
+    // 文件变小时不再缓冲：丢弃旧的缓冲内容，直接写入并释放多余的块
+    if (content.size() < inode.size) {
+        drop_pending_locked(inode_id);
+        return write_inode_data(inode_id, content, false);
+    }
+
+    PendingWrite& entry = pending_writes_[inode_id];
+
+    // 只为超出已分配块的部分预留额度，多退少补
+    const uint32_t needed = calculate_blocks_needed(content.size());
+    const uint32_t wanted = needed > inode.block_count ? needed - inode.block_count : 0;
+    if (wanted > entry.reserved_blocks) {
+        if (!bitmap_->reserve_blocks(wanted - entry.reserved_blocks)) {
+            // 空间不足以预留：放弃延迟，立即按实际分配写入
+            const bool growth = reserve_growth || entry.reserve_growth;
+            drop_pending_locked(inode_id);
+            return write_inode_data(inode_id, content, growth);
+        }
+    } else {
+        bitmap_->release_reservation(entry.reserved_blocks - wanted);
+    }
+    entry.reserved_blocks = wanted;
+    entry.reserve_growth = entry.reserve_growth || reserve_growth;
+
+    pending_bytes_ = pending_bytes_ - entry.data.size() + content.size();
+    entry.data = content;
+
+    // inode中先记录新的大小，块信息在写回时更新
+    inode.size = content.size();
+    inode.modify_time = time(nullptr);
+    if (!write_inode(inode_id, &inode)) {
+        return false;
+    }
+
+    // 缓冲数据过多时全部写回
+    if (pending_bytes_ > DELALLOC_MAX_PENDING_BYTES) {
+        bool ok = true;
+        while (!pending_writes_.empty()) {
+            ok = flush_pending_locked(pending_writes_.begin()->first) && ok;
+        }
+        return ok;
+    }
+    return true;
+}
+
+bool INodeManager::flush_pending(const uint32_t inode_id) const
+{
+    LockGuard<SimpleMutex> lock(pending_mutex_);
+    return flush_pending_locked(inode_id);
+}
+
+bool INodeManager::flush_all_pending() const
+{
+    LockGuard<SimpleMutex> lock(pending_mutex_);
+    bool ok = true;
+    while (!pending_writes_.empty()) {
+        ok = flush_pending_locked(pending_writes_.begin()->first) && ok;
+    }
+    return ok;
+}
+
+bool INodeManager::flush_pending_locked(const uint32_t inode_id) const
+{
+    const auto it = pending_writes_.find(inode_id);
+    if (it == pending_writes_.end()) {
+        return true;
+    }
+    const PendingWrite entry = std::move(it->second);
+    pending_writes_.erase(it);
+    pending_bytes_ -= entry.data.size();
+
+    // 归还预留额度后按最终大小一次性分配并写入
+    bitmap_->release_reservation(entry.reserved_blocks);
+    return write_inode_data(inode_id, entry.data, entry.reserve_growth);
+}
+
+void INodeManager::discard_pending(const uint32_t inode_id) const
+{
+    LockGuard<SimpleMutex> lock(pending_mutex_);
+    drop_pending_locked(inode_id);
+}
+
+void INodeManager::drop_pending_locked(const uint32_t inode_id) const
+{
+    const auto it = pending_writes_.find(inode_id);
+    if (it == pending_writes_.end()) {
+        return;
+    }
+    bitmap_->release_reservation(it->second.reserved_blocks);
+    pending_bytes_ -= it->second.data.size();
+    pending_writes_.erase(it);
 }
 
 bool INodeManager::read_file_block(const std::string& path, const uint32_t block_index, std::string& content) const
@@ -811,24 +1853,45 @@ bool INodeManager::read_file_block(const std::string& path, const uint32_t block
 
 bool INodeManager::read_file_block_data(const uint32_t inode_id,const uint32_t block_index, std::string& content) const
 {
+    // 按块访问前先写回缓冲数据
+    if (!flush_pending(inode_id)) {
+        return false;
+    }
+
     INode inode;
     if (!read_inode(inode_id, &inode) || inode.type != FS_FILE) {
         return false;
     }
 
-    // 检查块索引是否有效
-    if (block_index >= inode.block_count) {
+    // 内联文件只有第0块
+    if (is_inline(inode)) {
+        if (block_index != 0 || inode.size == 0) {
+            return false;
+        }
+        content.assign(inode.inline_data, std::min<uint32_t>(inode.size, INODE_INLINE_DATA_MAX));
+        return true;
+    }
+
+    // 检查块索引是否有效（文件末尾之后的预分配块不可读）
+    if (block_index >= calculate_blocks_needed(inode.size)) {
+        return false;
+    }
+
+    // 通过区段表找到物理块
+    std::vector<Extent> extents;
+    if (!load_extents(inode, extents)) {
         return false;
     }
+    const uint32_t block_no = map_block(extents, block_index);
 
     // 计算实际需要读取的字节数
     const size_t offset = block_index * BLOCK_SIZE;
     const size_t remaining = inode.size - offset;
     const size_t read_size = std::min(static_cast<size_t>(BLOCK_SIZE), remaining);
 
-    // **[修复]** 读取数据块，通过缓存
-    std::vector<uint8_t> block_data(BLOCK_SIZE);
-    if (!cache_->read_block(inode.start_block + block_index, block_data.data())) {
+    // **[修复]** 读取数据块，通过缓存；空洞读出为0
+    std::vector<uint8_t> block_data(BLOCK_SIZE, 0);
+    if (block_no != UINT32_MAX && !cache_->read_block(block_no, block_data.data(), cache_class_of(inode))) {
         return false;
     }
 
@@ -849,38 +1912,29 @@ bool INodeManager::write_file_block(const std::string& path,const uint32_t block
 
 bool INodeManager::write_file_block_data(const uint32_t inode_id, const uint32_t block_index, const std::string& content) const
 {
-    INode inode;
-    if (!read_inode(inode_id, &inode) || inode.type != FS_FILE) {
+    if (block_index >= INODE_MAX_FILE_SIZE / BLOCK_SIZE) {
         return false;
     }
 
-    // 如果要写入的块索引超出当前文件大小，需要调整文件大小
-    if (block_index >= inode.block_count) {
-        const uint32_t new_size = (block_index + 1) * BLOCK_SIZE;
-        if (!resize_inode(inode_id, new_size)) {
-            return false;
-        }
-        // 重新读取调整大小后的inode
-        if (!read_inode(inode_id, &inode)) {
-            return false;
-        }
-    }
-
-    std::vector<uint8_t> block_data(BLOCK_SIZE, 0);
-    const size_t copy_size = std::min(static_cast<size_t>(BLOCK_SIZE), content.size());
-
-    if (copy_size > 0) {
-        memcpy(block_data.data(), content.data(), copy_size);
+    // 先写回缓冲数据，文件大小才是最终值
+    if (!flush_pending(inode_id)) {
+        return false;
     }
 
-    // **[修复]** 写入数据块，通过缓存
-    if (!cache_->write_block(inode.start_block + block_index, block_data.data())) {
+    INode inode;
+    if (!read_inode(inode_id, &inode) || inode.type != FS_FILE) {
         return false;
     }
 
-    // 更新修改时间
-    inode.modify_time = time(nullptr);
-    return write_inode(inode_id, &inode);
+    // 整块写入（不足一块补0）；块索引超出文件末尾时文件增长到该块末尾，跳过的块保持为空洞，不分配也不写入。
+    // 文件范围内的块只写到文件末尾为止，文件大小不变
+    const uint32_t offset = block_index * BLOCK_SIZE;
+    const uint32_t length = block_index < calculate_blocks_needed(inode.size)
+                                ? std::min<uint32_t>(BLOCK_SIZE, inode.size - offset)
+                                : BLOCK_SIZE;
+    std::vector<char> block_data(BLOCK_SIZE, 0);
+    memcpy(block_data.data(), content.data(), std::min(static_cast<size_t>(BLOCK_SIZE), content.size()));
+    return write_at(inode_id, offset, block_data.data(), length);
 }
 
 bool INodeManager::directory_exists(const std::string& path) const
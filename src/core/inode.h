@@ -17,17 +17,59 @@
 // 根目录 ID
 #define ROOT_INODE_ID 1
 
+// 延迟分配缓冲的数据总量上限，超过后全部写回
+#define DELALLOC_MAX_PENDING_BYTES (4 * 1024 * 1024)
+
+// 文件增长时额外预留的块数比例（百分比）
+#define INODE_GROWTH_RESERVE_PERCENT 25
+
+// 在线整理的默认限速（块/秒）
+#define DEFRAG_DEFAULT_RATE 4096
+
+// inode内直接存放的区段数，超出部分放在一个溢出区段块中
+#define INODE_INLINE_EXTENTS 4
+
+// 区段：从文件内第logical块起，连续count块存放在磁盘start块开始处
+struct Extent {
+    uint32_t logical;               // 文件内起始块序号
+    uint32_t start;                 // 磁盘起始块号
+    uint32_t count;                 // 块数
+};
+
+// 溢出区段块可容纳的区段数
+#define INODE_OVERFLOW_EXTENTS (BLOCK_SIZE / sizeof(Extent))
+
+// 每个文件最多的区段数
+#define INODE_MAX_EXTENTS (INODE_INLINE_EXTENTS + INODE_OVERFLOW_EXTENTS)
+
+// inode记录大小（字节），inode表每块存放 BLOCK_SIZE / INODE_RECORD_SIZE 个
+#define INODE_RECORD_SIZE 512
+
+// 可直接存放在inode中的文件数据上限（字节），恰好把inode凑满INODE_RECORD_SIZE
+#define INODE_INLINE_DATA_MAX 348
+
+// 文件大小上限（字节），保证按块计算时不会超出 uint32_t
+#define INODE_MAX_FILE_SIZE (UINT32_MAX - BLOCK_SIZE + 1)
+
+// inode标志位
+#define INODE_FLAG_INLINE 0x1       // 数据内联在inode中，不占数据块
+
 // INode 结构体定义
 struct INode {
     uint32_t id;                    // 节点ID
     uint8_t type;                   // 类型（文件/目录）
     uint32_t size;                  // 文件大小（字节）
-    uint32_t start_block;           // 起始块号（连续存储）
-    uint32_t block_count;           // 占用块数
+    uint32_t start_block;           // 起始块号（第一个区段）
+    uint32_t block_count;           // 占用块数（所有区段之和）
     uint32_t parent_id;             // 父目录ID
     time_t create_time;             // 创建时间
     time_t modify_time;             // 修改时间
     char name[64];                  // 文件名/目录名
+    uint32_t extent_count;          // 区段数
+    uint32_t overflow_block;        // 溢出区段块号，0表示没有
+    Extent extents[INODE_INLINE_EXTENTS];   // 前几个区段，按logical升序
+    uint32_t flags;                 // INODE_FLAG_*
+    char inline_data[INODE_INLINE_DATA_MAX];    // 内联数据（INODE_FLAG_INLINE 时有效）
 };
 
 // 文件信息结构
@@ -40,10 +82,19 @@ struct FileInfo {
     time_t modify_time;
     uint32_t block_count;
     uint32_t start_block;
+    uint32_t extent_count;
+    bool inline_data;
     uint32_t inode_id;
 
     FileInfo() : is_directory(false), size(0), create_time(0), modify_time(0),
-                 block_count(0), start_block(0), inode_id(0) {}
+                 block_count(0), start_block(0), extent_count(0), inline_data(false), inode_id(0) {}
+};
+
+// 在线整理结果
+struct DefragStats {
+    uint32_t files_scanned = 0;     // 检查过的文件数
+    uint32_t files_moved = 0;       // 搬迁的文件数
+    uint32_t blocks_moved = 0;      // 复制的数据块数
 };
 
 class INodeManager {
@@ -52,20 +103,43 @@ public:
     ~INodeManager();
 
     // 初始化和格式化
-    static bool initialize();
+    // initialize 从磁盘装入inode位图；format 清空inode位图（格式化时调用，之后再创建根目录）
+    bool initialize();
+    bool format();
     bool create_root_directory();
+    // 把inode位图写回缓存（卸载时调用）
+    bool save_inode_bitmap() const;
+    bool is_inode_used(uint32_t inode_id) const;
 
     // 核心 inode 操作
     int32_t create_inode(uint32_t parent_id, uint8_t type,
                          const std::string& name, uint32_t size);
     bool read_inode(uint32_t inode_id, INode* node) const;
     bool write_inode(uint32_t inode_id, const INode* node) const;
+    // 把内存inode表中的脏inode按inode表块成批写回缓存
+    bool flush_inode_table() const;
     bool delete_inode(uint32_t inode_id);
     int32_t find_inode(uint32_t parent_id, const std::string& name) const;
 
     // 辅助功能
     bool resize_inode(uint32_t inode_id, uint32_t new_size) const;
+    // 预分配：保证文件至少占有容纳length字节的块，文件大小不变（类似 fallocate KEEP_SIZE）
+    bool preallocate_inode(uint32_t inode_id, uint32_t length) const;
+    // 截断：缩小时释放新末尾之后的块而不读写其中的数据，扩大时新增部分为空洞（读出为0，不占块）
+    bool truncate_inode(uint32_t inode_id, uint32_t size) const;
+    // 在线整理：把文件依次挪向数据区开头以合并空闲空间，按blocks_per_second限速（0表示不限速）
+    DefragStats defragment(uint32_t blocks_per_second = DEFRAG_DEFAULT_RATE, uint32_t max_moves = UINT32_MAX) const;
+
+    // 延迟分配：把缓冲的文件数据写回磁盘（此时才选择物理块）
+    bool flush_pending(uint32_t inode_id) const;
+    bool flush_all_pending() const;
     uint32_t get_total_inodes() const;
+    // Inode表占用的块数
+    static uint32_t get_inode_table_blocks();
+    // inode位图占用的块数
+    static uint32_t get_inode_bitmap_blocks();
+    // 块位图之后保留的元数据块数（inode位图 + Inode表）
+    static uint32_t get_metadata_blocks();
 
     // 文件系统操作
     bool create_file(const std::string& path, const std::string& content = "");
@@ -73,12 +147,26 @@ public:
     bool delete_file(const std::string& path);
     bool delete_directory(const std::string& path);
     bool read_inode_data(uint32_t inode_id, std::string& content) const;
+    // 取得写回缓冲数据后的inode与区段表（供流式读取使用）
+    bool get_layout(uint32_t inode_id, INode& node, std::vector<Extent>& extents) const;
+    // 目录块属于元数据，其余为普通数据
+    static CacheClass cache_class_of(const INode& node);
 
     // 文件读写操作
     bool read_file(const std::string& path, std::string& content) const;
     bool write_file(const std::string& path, const std::string& content) const;
     bool read_file_block(const std::string& path, uint32_t block_index, std::string& content) const;
     bool write_file_block(const std::string& path, uint32_t block_index, const std::string& content) const;
+    // 按偏移读写：只访问涉及的块，不足一块的部分先读出再修改；读取超出文件末尾的部分被截掉，写入超出时文件随之增长
+    bool read_at(const std::string& path, uint32_t offset, uint32_t length, std::string& content) const;
+    bool write_at(const std::string& path, uint32_t offset, const std::string& data) const;
+    bool read_at(uint32_t inode_id, uint32_t offset, char* buffer, uint32_t length, uint32_t& bytes_read) const;
+    bool write_at(uint32_t inode_id, uint32_t offset, const char* data, uint32_t length) const;
+    // 追加写：只写尾部涉及的块，块按增长预留成比例扩大，多次追加的分配开销被摊平
+    bool append(const std::string& path, const std::string& data) const;
+    bool append(uint32_t inode_id, const char* data, uint32_t length) const;
+    bool preallocate(const std::string& path, uint32_t length) const;
+    bool truncate(const std::string& path, uint32_t size) const;
 
     // 目录操作
     std::vector<FileInfo> list_directory(const std::string& path) const;
@@ -99,17 +187,67 @@ private:
     // 磁盘和资源管理
     VirtualDisk* disk_;             // 虚拟磁盘指针
     FreeBitmap* bitmap_;            // 空闲块位图
-    uint32_t inode_table_start_ = 1;    // INode表起始块号
+    uint32_t inode_bitmap_start_ = 1;   // inode位图起始块号（紧随块位图之后）
+    uint32_t inode_table_start_ = 2;    // INode表起始块号（紧随inode位图之后）
     uint32_t inode_count_ = 0;      // 当前INode数量
     uint32_t max_inodes_ = MAX_FILES;           // 最大inode数量
 
+    // 内存中的inode表：按inode表块按需装入，写入只修改内存并置脏，flush_inode_table 时整块写回
+    mutable std::vector<INode> inode_table_;        // 全部inode的内存副本
+    mutable std::vector<bool> table_block_loaded_;  // 每个inode表块是否已装入
+    mutable std::vector<bool> inode_dirty_;         // 每个inode的脏标记
+    mutable SimpleMutex table_mutex_;               // 保护以上三项
+
     // 目录缓存
     mutable std::unordered_map<uint32_t, std::shared_ptr<Directory>> directory_cache_;
     mutable SimpleMutex cache_mutex_;
 
+    // 延迟分配：文件写入只更新大小并预留块数，数据留在内存中，写回时再按最终大小分配
+    struct PendingWrite {
+        std::string data;               // 文件的完整新内容
+        uint32_t reserved_blocks = 0;   // 为超出已分配块的部分预留的块数
+        bool reserve_growth = false;    // 写回时是否附带预留增长空间
+    };
+    mutable std::unordered_map<uint32_t, PendingWrite> pending_writes_;
+    mutable size_t pending_bytes_ = 0;  // 缓冲数据总量
+    mutable SimpleMutex pending_mutex_; // 保护以上两项
+
     // 私有方法
     static uint32_t calculate_blocks_needed(uint32_t size);
-    std::vector<bool> inode_used_;
+    bool load_table_block_locked(uint32_t table_block) const;
+    static uint32_t growth_reserve_blocks(uint32_t blocks);
+    bool resize_blocks(uint32_t inode_id, uint32_t new_size, bool reserve_growth = false) const;
+    bool extend_blocks(INode& node, uint32_t target_blocks) const;
+    bool convert_inline(INode& node, uint32_t target_blocks) const;
+    static bool is_inline(const INode& node);
+    bool copy_data_blocks(const INode& node, const std::vector<Extent>& extents, uint32_t new_start, uint32_t new_count) const;
+    bool relocate_extents(INode& node, std::vector<Extent>& extents, uint32_t new_start, uint32_t target_blocks) const;
+
+    // 区段表：inode内的区段加上溢出块中的区段
+    bool load_extents(const INode& node, std::vector<Extent>& extents) const;
+    bool store_extents(INode& node, const std::vector<Extent>& extents) const;
+    void free_extents(std::vector<Extent>& extents, uint32_t keep_blocks) const;
+    // 为 [first, first + count) 中未映射的块分配空间（不写数据），失败时不留下任何分配
+    bool allocate_range(INode& node, std::vector<Extent>& extents, uint32_t first, uint32_t count) const;
+    // 把 [from, to) 中已分配的块清零，空洞保持不分配
+    bool zero_range(const INode& node, const std::vector<Extent>& extents, uint32_t from, uint32_t to) const;
+    static uint32_t map_block(const std::vector<Extent>& extents, uint32_t logical);
+    static uint32_t mapped_end(const std::vector<Extent>& extents);
+    static bool is_sparse(const std::vector<Extent>& extents);
+    bool relocate_lower(uint32_t inode_id, uint32_t& moved_blocks) const;
+    bool write_delayed(uint32_t inode_id, const std::string& content, bool reserve_growth) const;
+    bool flush_pending_locked(uint32_t inode_id) const;
+    void drop_pending_locked(uint32_t inode_id) const;
+    void discard_pending(uint32_t inode_id) const;
+
+    // inode位图：每位表示一个inode是否已使用，与磁盘上的inode位图块格式相同（由 allocation_mutex_ 保护）
+    std::vector<uint64_t> inode_bitmap_;
+    size_t inode_hint_word_ = 0;                 // 下次查找空闲inode的起始字
+    mutable bool inode_bitmap_dirty_ = false;    // inode位图是否需要写回
+    void reset_inode_bitmap();
+    int32_t allocate_inode_slot();
+    bool claim_inode_slot(uint32_t inode_id);
+    void release_inode_slot(uint32_t inode_id);
 
     // 目录相关的私有方法
     bool load_directory_content(uint32_t dir_id, Directory& dir) const;
@@ -123,7 +261,7 @@ private:
     static std::string normalize_path(const std::string& path);
     static bool is_valid_filename(const std::string& name);
 
-    bool write_inode_data(uint32_t inode_id, const std::string& content) const;
+    bool write_inode_data(uint32_t inode_id, const std::string& content, bool reserve_growth = false) const;
     // 文件读写辅助方法
     bool read_file_data(uint32_t inode_id, std::string& content) const;
     bool write_file_data(uint32_t inode_id, const std::string& content) const;
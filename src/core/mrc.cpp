@@ -0,0 +1,119 @@
+#include "mrc.h"
+#include <algorithm>
+#include <cmath>
+
+MissRatioCurve::MissRatioCurve(const double sample_rate)
+    : threshold_(std::max<uint64_t>(1, static_cast<uint64_t>(std::clamp(sample_rate, 0.0, 1.0) * MODULUS))),
+      rate_(static_cast<double>(threshold_) / MODULUS),
+      histogram_(65, 0) {
+    tree_.assign(1024 + 1, 0);
+}
+
+uint64_t MissRatioCurve::hash_block(const uint32_t block_no) {
+    // splitmix64 混合，保证采样与块号分布无关
+    uint64_t x = block_no + 0x9e3779b97f4a7c15ULL;
+    x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+    x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+    return x ^ (x >> 31);
+}
+
+void MissRatioCurve::tree_add(const uint32_t pos, const int32_t delta) {
+    for (size_t i = pos + 1; i < tree_.size(); i += i & (~i + 1)) {
+        tree_[i] += delta;
+    }
+}
+
+uint32_t MissRatioCurve::tree_prefix(const uint32_t pos) const {
+    // 统计时间戳 [0, pos) 内的标记数
+    int64_t sum = 0;
+    for (size_t i = pos; i > 0; i -= i & (~i + 1)) {
+        sum += tree_[i];
+    }
+    return static_cast<uint32_t>(sum);
+}
+
+void MissRatioCurve::compact() {
+    // 时间戳用尽时按原顺序重新编号，只保留每个块的最近一次访问
+    std::vector<std::pair<uint32_t, uint32_t>> live;
+    live.reserve(last_access_.size());
+    for (const auto& [block, ts] : last_access_) {
+        live.emplace_back(ts, block);
+    }
+    std::sort(live.begin(), live.end());
+
+    const size_t capacity = std::max<size_t>(1024, live.size() * 2);
+    tree_.assign(capacity + 1, 0);
+    clock_ = 0;
+    for (const auto& [ts, block] : live) {
+        last_access_[block] = clock_;
+        tree_add(clock_, 1);
+        ++clock_;
+    }
+}
+
+void MissRatioCurve::record(const uint32_t block_no) {
+    LockGuard<SimpleMutex> lock(mutex_);
+    ++total_refs_;
+
+    if (hash_block(block_no) % MODULUS >= threshold_) {
+        return;
+    }
+    ++sampled_refs_;
+
+    if (clock_ + 1 >= tree_.size()) {
+        compact();
+    }
+
+    const auto it = last_access_.find(block_no);
+    if (it == last_access_.end()) {
+        ++cold_misses_;
+        last_access_[block_no] = clock_;
+    } else {
+        // 上次访问之后出现过的不同块数即为栈距离，再按采样率放大
+        const uint32_t distinct = tree_prefix(clock_) - tree_prefix(it->second + 1);
+        const auto scaled = static_cast<uint64_t>(distinct / rate_);
+        size_t bucket = 0;
+        while (bucket < 64 && (scaled >> bucket) != 0) {
+            ++bucket;
+        }
+        ++histogram_[bucket];
+        tree_add(it->second, -1);
+        it->second = clock_;
+    }
+    tree_add(clock_, 1);
+    ++clock_;
+}
+
+std::vector<MrcPoint> MissRatioCurve::curve(const uint64_t max_pages) const {
+    LockGuard<SimpleMutex> lock(mutex_);
+
+    std::vector<MrcPoint> points;
+    if (sampled_refs_ == 0) {
+        return points;
+    }
+
+    // 距离 d < 2^k 当且仅当 d 的位宽 <= k，因此2的幂大小可由直方图前缀精确得到
+    uint64_t hits = 0;
+    size_t bucket = 0;
+    for (uint64_t pages = MRC_MIN_PAGES; ; pages *= 2) {
+        const auto width = static_cast<size_t>(std::log2(static_cast<double>(pages)));
+        while (bucket <= width && bucket < histogram_.size()) {
+            hits += histogram_[bucket++];
+        }
+        points.push_back({pages, 1.0 - static_cast<double>(hits) / sampled_refs_});
+        if (pages >= max_pages || pages > (UINT64_MAX >> 1)) {
+            break;
+        }
+    }
+    return points;
+}
+
+uint64_t MissRatioCurve::get_total_refs() const {
+    LockGuard<SimpleMutex> lock(mutex_);
+    return total_refs_;
+}
+
+uint64_t MissRatioCurve::get_sampled_refs() const {
+    LockGuard<SimpleMutex> lock(mutex_);
+    return sampled_refs_;
+}
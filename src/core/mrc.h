@@ -0,0 +1,67 @@
+#ifndef MRC_H
+#define MRC_H
+
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "../process/sync.h"
+
+#define MRC_SAMPLE_RATE 0.1     // SHARDS 空间采样率
+#define MRC_MIN_PAGES 16        // 曲线的最小缓存页数
+
+// 缺失率曲线上的一个点
+struct MrcPoint {
+    uint64_t pages;             // 缓存页数
+    double miss_ratio;          // 预测缺失率
+};
+
+/**
+ * 在线缺失率曲线估计器（SHARDS）
+ * 按块号哈希做空间采样，对采样引用计算重用距离（LRU栈距离），
+ * 距离按采样率放大后计入对数直方图，据此预测任意缓存大小下的命中率
+ */
+class MissRatioCurve {
+    const uint64_t threshold_;              // 采样阈值：hash % MODULUS < threshold_ 时采样
+    const double rate_;                     // 实际采样率
+
+    std::unordered_map<uint32_t, uint32_t> last_access_; // 采样块 -> 最近一次访问的时间戳
+    std::vector<int32_t> tree_;             // 按时间戳索引的树状数组，标记每个块的最近访问
+    uint32_t clock_ = 0;                    // 下一个时间戳
+
+    std::vector<uint64_t> histogram_;       // 按距离位宽分桶的重用距离直方图
+    uint64_t cold_misses_ = 0;              // 首次访问（无限距离）
+    uint64_t sampled_refs_ = 0;             // 采样引用数
+    uint64_t total_refs_ = 0;               // 总引用数
+
+    mutable SimpleMutex mutex_;
+
+    static constexpr uint64_t MODULUS = 1u << 24;
+
+    static uint64_t hash_block(uint32_t block_no);
+    void tree_add(uint32_t pos, int32_t delta);
+    uint32_t tree_prefix(uint32_t pos) const;
+    void compact();
+
+public:
+    explicit MissRatioCurve(double sample_rate = MRC_SAMPLE_RATE);
+
+    /**
+     * 记录一次块访问
+     * @param block_no 块号
+     */
+    void record(uint32_t block_no);
+
+    /**
+     * 生成缺失率曲线，缓存大小从 MRC_MIN_PAGES 起按2倍递增
+     * @param max_pages 曲线覆盖的最大页数
+     * @return 每个缓存大小对应的预测缺失率
+     */
+    std::vector<MrcPoint> curve(uint64_t max_pages) const;
+
+    uint64_t get_total_refs() const;
+    uint64_t get_sampled_refs() const;
+    double get_sample_rate() const { return rate_; }
+};
+
+#endif //MRC_H
@@ -0,0 +1,43 @@
+#include "superblock.h"
+#include <cstring>
+#include <vector>
+
+static_assert(sizeof(SuperBlock) <= BLOCK_SIZE, "超级块必须能放入一个块");
+
+bool SuperBlock::is_valid(const uint32_t disk_blocks) const {
+    if (magic != SUPERBLOCK_MAGIC || version != SUPERBLOCK_VERSION || block_size != BLOCK_SIZE) {
+        return false;
+    }
+    if (total_blocks != disk_blocks) {
+        return false;
+    }
+    // 各区域必须按顺序首尾相接
+    return bitmap_start == SUPERBLOCK_BLOCK + SUPERBLOCK_BLOCKS &&
+           inode_bitmap_start == bitmap_start + bitmap_blocks &&
+           inode_table_start == inode_bitmap_start + inode_bitmap_blocks &&
+           first_data_block == inode_table_start + inode_table_blocks &&
+           first_data_block < total_blocks &&
+           root_inode < max_inodes;
+}
+
+bool SuperBlock::load(CacheManager* cache) {
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE);
+    if (!cache->read_block(SUPERBLOCK_BLOCK, block_buffer.data(), CacheClass::METADATA)) {
+        return false;
+    }
+    memcpy(this, block_buffer.data(), sizeof(SuperBlock));
+    return true;
+}
+
+bool SuperBlock::save(CacheManager* cache, const bool write_through) const {
+    std::vector<uint8_t> block_buffer(BLOCK_SIZE, 0);
+    memcpy(block_buffer.data(), this, sizeof(SuperBlock));
+    if (!cache->write_block(SUPERBLOCK_BLOCK, block_buffer.data(), CacheClass::METADATA)) {
+        return false;
+    }
+    if (write_through) {
+        // DONTNEED 会先回写脏页再丢弃
+        cache->advise(SUPERBLOCK_BLOCK, SUPERBLOCK_BLOCKS, CacheAdvice::DONTNEED);
+    }
+    return true;
+}
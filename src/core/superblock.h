@@ -0,0 +1,60 @@
+#ifndef SUPERBLOCK_H
+#define SUPERBLOCK_H
+
+#include <cstdint>
+#include <ctime>
+
+#include "cache.h"
+
+#define SUPERBLOCK_MAGIC 0x53465953     // 超级块魔数 "SYFS"
+#define SUPERBLOCK_VERSION 3            // 磁盘格式版本（2：inode改为区段表；3：inode扩大到512字节并支持内联数据）
+#define SUPERBLOCK_BLOCK 0              // 超级块所在块号
+#define SUPERBLOCK_BLOCKS 1             // 超级块占用的块数（位图紧随其后）
+
+/**
+ * 超级块
+ * 记录磁盘布局与计数，挂载时只需读取这一块即可确定各区域位置：
+ * [超级块][块位图][inode位图][inode表][数据块...]
+ * clean 在挂载后立即清零并写穿到磁盘，正常卸载时再置1，挂载时为0说明上次没有正常卸载
+ */
+struct SuperBlock {
+    uint32_t magic = 0;                 // 魔数
+    uint32_t version = 0;               // 格式版本
+    uint32_t block_size = 0;            // 块大小
+    uint32_t total_blocks = 0;          // 总块数
+    uint32_t bitmap_start = 0;          // 块位图起始块号
+    uint32_t bitmap_blocks = 0;         // 块位图块数
+    uint32_t inode_bitmap_start = 0;    // inode位图起始块号
+    uint32_t inode_bitmap_blocks = 0;   // inode位图块数
+    uint32_t inode_table_start = 0;     // inode表起始块号
+    uint32_t inode_table_blocks = 0;    // inode表块数
+    uint32_t first_data_block = 0;      // 第一个数据块
+    uint32_t max_inodes = 0;            // inode总数
+    uint32_t root_inode = 0;            // 根目录inode号
+    uint32_t free_blocks = 0;           // 卸载时的空闲块数
+    uint32_t used_inodes = 0;           // 卸载时已使用的inode数
+    uint32_t clean = 0;                 // 是否正常卸载
+    time_t format_time = 0;             // 格式化时间
+    time_t mount_time = 0;              // 最近挂载时间
+    time_t write_time = 0;              // 最近写回时间
+
+    /**
+     * 检查魔数、版本与布局是否自洽
+     * @param disk_blocks 磁盘实际块数
+     */
+    bool is_valid(uint32_t disk_blocks) const;
+
+    /**
+     * 通过缓存读取超级块
+     * @return true如果读取成功（不检查内容）
+     */
+    bool load(CacheManager* cache);
+
+    /**
+     * 通过缓存写入超级块
+     * @param write_through true时立即写回磁盘并丢弃缓存页（用于更新clean标记）
+     */
+    bool save(CacheManager* cache, bool write_through) const;
+};
+
+#endif //SUPERBLOCK_H
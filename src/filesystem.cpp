@@ -9,6 +9,7 @@
 #include <cctype>
 #include <ctime>
 #include <iomanip>
+#include <stdexcept>
 
 // 构造函数
 SimpleFileSystem::SimpleFileSystem() : mounted_(false), current_path_("/") {
@@ -30,18 +31,69 @@ bool SimpleFileSystem::format(const std::string& disk_file, const size_t size_mb
 
     // 使用一个临时的 VirtualDisk 对象来完成格式化操作
     // 它不影响类的成员 disk_
+    {
+        VirtualDisk temp_disk;
+        if (!temp_disk.create(disk_file, size_mb)) {
+            return false;
+        }
+        // 作用域结束时 temp_disk 被销毁，其文件流被自动关闭，这很安全。
+    }
+
+    // 重新打开以取得实际块数，再依次写入块位图、inode位图、根目录与超级块
     VirtualDisk temp_disk;
-    if (!temp_disk.create(disk_file, size_mb)) {
+    if (!temp_disk.open(disk_file)) {
+        return false;
+    }
+    CacheManager temp_cache(&temp_disk);
+    FreeBitmap temp_bitmap;
+    if (!temp_bitmap.initialize(&temp_cache, temp_disk.get_total_blocks(),
+                                INodeManager::get_metadata_blocks(), SUPERBLOCK_BLOCKS)) {
+        return false;
+    }
+    INodeManager temp_inodes(&temp_disk, &temp_bitmap, &temp_cache);
+    if (!temp_inodes.format() || !temp_inodes.create_root_directory()) {
+        return false;
+    }
+    if (!temp_inodes.flush_inode_table() || !temp_inodes.save_inode_bitmap() || !temp_bitmap.save()) {
         return false;
     }
-    // 函数结束时，temp_disk 被销毁，其文件流被自动关闭，这很安全。
+
+    SuperBlock sb = make_superblock(temp_bitmap);
+    sb.format_time = time(nullptr);
+    sb.write_time = sb.format_time;
+    sb.used_inodes = temp_inodes.get_total_inodes();
+    sb.clean = 1;
+    if (!sb.save(&temp_cache, false)) {
+        return false;
+    }
+    temp_cache.flush_all();
 
     std::cout << "格式化完成：" << disk_file << " (" << size_mb << "MB)" << std::endl;
     return true;
 }
 
+// 按位图的实际布局填写超级块的布局字段
+SuperBlock SimpleFileSystem::make_superblock(const FreeBitmap& bitmap) {
+    SuperBlock sb;
+    sb.magic = SUPERBLOCK_MAGIC;
+    sb.version = SUPERBLOCK_VERSION;
+    sb.block_size = BLOCK_SIZE;
+    sb.total_blocks = bitmap.get_total_blocks();
+    sb.bitmap_start = bitmap.get_bitmap_start();
+    sb.bitmap_blocks = bitmap.get_bitmap_blocks();
+    sb.inode_bitmap_start = sb.bitmap_start + sb.bitmap_blocks;
+    sb.inode_bitmap_blocks = INodeManager::get_inode_bitmap_blocks();
+    sb.inode_table_start = sb.inode_bitmap_start + sb.inode_bitmap_blocks;
+    sb.inode_table_blocks = INodeManager::get_inode_table_blocks();
+    sb.first_data_block = bitmap.get_first_data_block();
+    sb.max_inodes = MAX_FILES;
+    sb.root_inode = ROOT_INODE_ID;
+    sb.free_blocks = bitmap.get_free_blocks();
+    return sb;
+}
+
 // 挂载文件系统
-bool SimpleFileSystem::mount(const std::string& disk_file) {
+bool SimpleFileSystem::mount(const std::string& disk_file, const AllocatorKind allocator, const bool concurrent) {
     if (mounted_) {
         return false; // 已挂载
     }
@@ -56,16 +108,34 @@ bool SimpleFileSystem::mount(const std::string& disk_file) {
     // 2. 创建缓存管理器（必须在所有其他I/O组件之前）
     cache_ = std::make_unique<CacheManager>(disk_.get());
 
-    // 3. 初始化位图（通过缓存）
+    // 3. 读取超级块，布局以超级块记录为准
+    if (!superblock_.load(cache_.get()) || !superblock_.is_valid(disk_->get_total_blocks()) ||
+        superblock_.inode_table_blocks != INodeManager::get_inode_table_blocks() ||
+        superblock_.inode_bitmap_blocks != INodeManager::get_inode_bitmap_blocks() ||
+        superblock_.max_inodes != MAX_FILES) {
+        std::cerr << "磁盘未格式化或超级块无效：" << disk_file << std::endl;
+        cache_.reset();
+        disk_.reset();
+        return false;
+    }
+    if (!superblock_.clean) {
+        std::cerr << "警告：文件系统上次未正常卸载，空闲块数按位图重新统计" << std::endl;
+    }
+
+    // 4. 装入位图（通过缓存）
     bitmap_ = std::make_unique<FreeBitmap>();
-    if (!bitmap_->load(cache_.get(), disk_->get_total_blocks())) {
+    if (!bitmap_->load(cache_.get(), superblock_.total_blocks,
+                       superblock_.first_data_block - superblock_.inode_bitmap_start, superblock_.bitmap_start)) {
         cache_.reset();
         bitmap_.reset();
         disk_.reset();
         return false;
     }
+    // 切换到伙伴模式会关闭无锁并发模式，因此先设置并发模式
+    bitmap_->set_concurrent_mode(concurrent);
+    bitmap_->set_allocator(allocator);
 
-    // 4. 创建inode管理器
+    // 5. 创建inode管理器并装入inode位图
     inode_manager_ = std::make_unique<INodeManager>(disk_.get(), bitmap_.get(), cache_.get());
     if (!inode_manager_->initialize()) {
         inode_manager_.reset();
@@ -75,10 +145,9 @@ bool SimpleFileSystem::mount(const std::string& disk_file) {
         return false;
     }
 
-    // 5. 创建根目录（如果需要）
+    // 6. 创建根目录（如果需要）
     // 检查根目录inode是否存在，如果不存在则创建
-    INode root_node;
-    if (!inode_manager_->read_inode(ROOT_INODE_ID, &root_node)) {
+    if (!inode_manager_->is_inode_used(ROOT_INODE_ID)) {
         if (!inode_manager_->create_root_directory()) {
             inode_manager_.reset();
             cache_.reset();
@@ -88,11 +157,22 @@ bool SimpleFileSystem::mount(const std::string& disk_file) {
         }
     }
 
+    // 7. 清除clean标记并立即写穿，崩溃后再次挂载时可以发现
+    superblock_.clean = 0;
+    superblock_.mount_time = time(nullptr);
+    superblock_.save(cache_.get(), true);
+
     // 保存磁盘文件名并标记为已挂载
     disk_file_ = disk_file;
     mounted_ = true;
     std::cout << "文件系统已挂载：" << disk_file << std::endl;
 
+    // 8. 按上次卸载时保存的热点集合预热缓存
+    const size_t prewarmed = cache_->prewarm(hot_set_path());
+    if (prewarmed > 0) {
+        std::cout << "缓存预热：装入 " << prewarmed << " 个块" << std::endl;
+    }
+
     return true;
 }
 
@@ -102,12 +182,29 @@ void SimpleFileSystem::unmount() {
         return;
     }
 
+    // 先写回延迟分配的文件数据，此时才为它们分配物理块；再把内存inode表中的脏inode与inode位图写回
+    if (inode_manager_) {
+        inode_manager_->flush_all_pending();
+        inode_manager_->flush_inode_table();
+        inode_manager_->save_inode_bitmap();
+    }
+
     // 确保所有缓存数据写回磁盘
     if (cache_) {
+        // 记录当前驻留块，供下次挂载时预热
+        cache_->save_hot_set(hot_set_path());
         // 先保存位图到缓存
         if (bitmap_) {
             bitmap_->save();
         }
+        // 所有元数据写入缓存后再更新超级块并置clean标记
+        if (bitmap_ && inode_manager_) {
+            superblock_.free_blocks = bitmap_->get_free_blocks();
+            superblock_.used_inodes = inode_manager_->get_total_inodes();
+            superblock_.write_time = time(nullptr);
+            superblock_.clean = 1;
+            superblock_.save(cache_.get(), false);
+        }
         // 再将所有脏页（包括位图）写回磁盘
         cache_->flush_all();
     }
@@ -126,6 +223,11 @@ void SimpleFileSystem::unmount() {
     std::cout << "文件系统已卸载" << std::endl;
 }
 
+// 热点集合文件与磁盘镜像放在一起
+std::string SimpleFileSystem::hot_set_path() const {
+    return disk_file_ + ".hot";
+}
+
 // cd命令实现
 bool SimpleFileSystem::change_directory(const std::string& path) {
     if (!mounted_) return false;
@@ -207,6 +309,33 @@ int SimpleFileSystem::read_file(const std::string& path, std::string& content) {
     return success ? 0 : -2;
 }
 
+// 流式读取文件内容，内存占用与文件大小无关
+int SimpleFileSystem::read_stream(const std::string& path, const std::function<bool(const char*, size_t)>& consumer) {
+    if (!mounted_) {
+        return -1;
+    }
+
+    const std::string normalized_path = normalize_path(path);
+    const FileInfo info = inode_manager_->get_file_info(normalized_path);
+    if (info.inode_id == 0 || info.is_directory) {
+        return -2;
+    }
+
+    open_file(normalized_path);
+    bool success;
+    {
+        FileReader reader(inode_manager_.get(), cache_.get(), info.inode_id);
+        const char* data;
+        size_t length;
+        while (reader.next(data, length) && consumer(data, length)) {
+        }
+        success = reader.is_open() && !reader.failed();
+    }
+    close_file(normalized_path);
+
+    return success ? 0 : -2;
+}
+
 // 写入文件内容
 int SimpleFileSystem::write_file(const std::string& path, const std::string& content) {
     if (!mounted_) {
@@ -233,6 +362,114 @@ int SimpleFileSystem::write_file(const std::string& path, const std::string& con
     return 0; // 成功
 }
 
+// 按偏移读取文件的一部分
+int SimpleFileSystem::read_at(const std::string& path, const uint32_t offset, const uint32_t length, std::string& content) {
+    if (!mounted_) {
+        return -1;
+    }
+
+    const std::string normalized_path = normalize_path(path);
+
+    open_file(normalized_path);
+    const bool success = inode_manager_->read_at(normalized_path, offset, length, content);
+    close_file(normalized_path);
+
+    return success ? 0 : -2;
+}
+
+// 按偏移写入文件的一部分，文件不存在时先创建空文件
+int SimpleFileSystem::write_at(const std::string& path, const uint32_t offset, const std::string& data) {
+    if (!mounted_) {
+        return -1;
+    }
+
+    const std::string normalized_path = normalize_path(path);
+    if (is_file_protected(normalized_path)) {
+        return -2; // 文件被占用
+    }
+
+    if (inode_manager_->get_file_info(normalized_path).inode_id == 0) {
+        const int result = create_file(normalized_path, "");
+        if (result != 0) {
+            return result;
+        }
+    }
+
+    if (!inode_manager_->write_at(normalized_path, offset, data)) {
+        return -3; // 写入失败
+    }
+
+    return 0; // 成功
+}
+
+// 追加写入，文件不存在时先创建空文件
+int SimpleFileSystem::append(const std::string& path, const std::string& data) {
+    if (!mounted_) {
+        return -1;
+    }
+
+    const std::string normalized_path = normalize_path(path);
+    if (is_file_protected(normalized_path)) {
+        return -2; // 文件被占用
+    }
+
+    if (inode_manager_->get_file_info(normalized_path).inode_id == 0) {
+        return create_file(normalized_path, data);
+    }
+
+    if (!inode_manager_->append(normalized_path, data)) {
+        return -3; // 写入失败
+    }
+
+    return 0; // 成功
+}
+
+// 预分配文件空间（文件大小不变）
+int SimpleFileSystem::preallocate_file(const std::string& path, const uint32_t length) {
+    if (!mounted_) {
+        return -1;
+    }
+
+    const std::string normalized_path = normalize_path(path);
+    if (is_file_protected(normalized_path)) {
+        return -2; // 文件被占用
+    }
+
+    if (!inode_manager_->preallocate(normalized_path, length)) {
+        return -3; // 文件不存在或空间不足
+    }
+
+    return 0; // 成功
+}
+
+// 截断或扩大文件（扩大的部分为空洞）
+int SimpleFileSystem::truncate_file(const std::string& path, const uint32_t size) {
+    if (!mounted_) {
+        return -1;
+    }
+
+    const std::string normalized_path = normalize_path(path);
+    if (is_file_protected(normalized_path)) {
+        return -2; // 文件被占用
+    }
+
+    if (!inode_manager_->truncate(normalized_path, size)) {
+        return -3; // 文件不存在或空间不足
+    }
+
+    return 0; // 成功
+}
+
+// 在线整理空闲空间
+int SimpleFileSystem::defragment(const uint32_t blocks_per_second, DefragStats& stats) {
+    if (!mounted_) {
+        return -1;
+    }
+
+    stats = inode_manager_->defragment(blocks_per_second);
+    return 0;
+}
+
 // 创建目录
 int SimpleFileSystem::create_directory(const std::string& parent_path, const std::string& name) const
 {
@@ -368,9 +605,37 @@ void SimpleFileSystem::print_disk_usage() const
               << used_blocks << " 块, " << usage_percent << "%)" << std::endl;
     std::cout << "空闲: " << std::fixed << std::setprecision(2) << free_mb << " MB ("
               << free_blocks << " 块, " << (100.0 - usage_percent) << "%)" << std::endl;
+    std::cout << "分配器: " << (bitmap_->get_allocator() == AllocatorKind::BUDDY ? "伙伴系统" : "位图")
+              << (bitmap_->is_concurrent_mode() ? "（无锁并发）" : "") << std::endl;
+
+    const uint32_t reserved_blocks = bitmap_->get_reserved_blocks();
+    if (reserved_blocks > 0) {
+        std::cout << "延迟分配预留: " << reserved_blocks << " 块" << std::endl;
+    }
 
     const uint32_t total_inodes = inode_manager_->get_total_inodes();
     std::cout << "已使用 INode 数量: " << total_inodes << std::endl;
+
+    // 碎片情况：文件必须连续存放，空闲区段越分散，扩展与大文件创建越容易失败
+    const FragmentationStats frag = bitmap_->get_fragmentation();
+    std::cout << "空闲区段: " << frag.free_extents << " 个, 最大 " << frag.largest_extent
+              << " 块, 碎片化程度 " << std::fixed << std::setprecision(2) << frag.score() << "%" << std::endl;
+    std::cout << "空闲区段长度分布:" << std::endl;
+    for (size_t i = 0; i < frag.histogram.size(); ++i) {
+        if (frag.histogram[i] == 0) {
+            continue;
+        }
+        const uint32_t low = 1u << i;
+        std::cout << "  " << low;
+        if (i + 1 < frag.histogram.size()) {
+            if (low > 1) {
+                std::cout << "-" << (2 * low - 1);
+            }
+        } else {
+            std::cout << "+";
+        }
+        std::cout << " 块: " << frag.histogram[i] << std::endl;
+    }
 }
 
 // 打印缓存状态
@@ -464,6 +729,32 @@ bool SimpleFileSystem::is_valid_filename(const std::string& name) {
     return true;
 }
 
+// 解析命令行中的非负整数：不带符号、整个字符串都是数字且不超过 max_value
+bool SimpleFileSystem::parse_uint(const std::string& text, const uint32_t max_value, uint32_t& value) {
+    if (text.empty() || !std::isdigit(static_cast<unsigned char>(text[0]))) {
+        return false; // stoull 会把负数回绕成很大的正数，需提前拒绝
+    }
+
+    size_t parsed = 0;
+    unsigned long long parsed_value;
+    try {
+        parsed_value = std::stoull(text, &parsed);
+    } catch (const std::exception&) {
+        return false;
+    }
+    if (parsed != text.size() || parsed_value > max_value) {
+        return false;
+    }
+
+    value = static_cast<uint32_t>(parsed_value);
+    return true;
+}
+
+// 解析命令行中的字节数：只接受不超过文件大小上限的非负整数
+bool SimpleFileSystem::parse_file_size(const std::string& text, uint32_t& size) {
+    return parse_uint(text, INODE_MAX_FILE_SIZE, size);
+}
+
 // 检查文件是否被保护（已打开）
 bool SimpleFileSystem::is_file_protected(const std::string& path) {
     const auto it = open_files_.find(path);
@@ -526,6 +817,12 @@ void SimpleFileSystem::handle_command(const std::string& command) {
         cmd_rmdir(args);
     } else if (cmd == "edit") {
         cmd_edit(args);
+    } else if (cmd == "fallocate") {
+        cmd_fallocate(args);
+    } else if (cmd == "truncate") {
+        cmd_truncate(args);
+    } else if (cmd == "defrag") {
+        cmd_defrag(args);
     } else if (cmd == "help") {
         cmd_help();
     } else {
@@ -623,6 +920,11 @@ void SimpleFileSystem::cmd_file_info(const std::vector<std::string>& args) {
 
     std::cout << "类型: " << (info.is_directory ? "目录" : "文件") << std::endl;
     std::cout << "大小: " << info.size << " 字节" << std::endl;
+    std::cout << "占用块数: " << info.block_count << std::endl;
+    std::cout << "区段数: " << info.extent_count << std::endl;
+    if (info.inline_data) {
+        std::cout << "存储方式: 内联（数据保存在inode中）" << std::endl;
+    }
     std::cout << "创建时间: " << time_str << std::endl;
     std::cout << "INode ID: " << info.inode_id << std::endl;
 }
@@ -650,11 +952,14 @@ void SimpleFileSystem::cmd_cat(const std::vector<std::string>& args) {
         return;
     }
 
-    std::string content;
-    const int result = read_file(args[1], content);
+    // 逐块直接输出缓存页中的数据，大文件也不需要整份读入内存
+    const int result = read_stream(args[1], [](const char* data, const size_t length) {
+        std::cout.write(data, static_cast<std::streamsize>(length));
+        return true;
+    });
 
     if (result == 0) {
-        std::cout << content << std::endl;
+        std::cout << std::endl;
     } else {
         std::cout << "读取文件失败，错误码: " << result << std::endl;
     }
@@ -662,15 +967,16 @@ void SimpleFileSystem::cmd_cat(const std::vector<std::string>& args) {
 
 // echo命令
 void SimpleFileSystem::cmd_echo(const std::vector<std::string>& args) {
-    if (args.size() < 3 || args[args.size() - 2] != ">") {
-        std::cout << "用法: echo <内容> > <文件路径>" << std::endl;
+    const std::string redirect = args.size() < 3 ? "" : args[args.size() - 2];
+    if (redirect != ">" && redirect != ">>") {
+        std::cout << "用法: echo <内容> > <文件路径>  或  echo <内容> >> <文件路径>" << std::endl;
         return;
     }
 
     std::string content;
     if (args.size() > 3) {
         for (size_t i = 1; i < args.size(); ++i) {
-            if (args[i] == ">") {
+            if (args[i] == ">" || args[i] == ">>") {
                 break; // 停止在重定向符号
             }
 
@@ -679,7 +985,8 @@ void SimpleFileSystem::cmd_echo(const std::vector<std::string>& args) {
         }
     }
 
-    const int result = write_file(args.back(), content);
+    // >> 追加到末尾，只写尾部的块
+    const int result = redirect == ">>" ? append(args.back(), content) : write_file(args.back(), content);
 
     if (result == 0) {
         std::cout << "写入文件成功: " << args.back() << std::endl;
@@ -783,6 +1090,69 @@ void SimpleFileSystem::cmd_edit(const std::vector<std::string>& args) {
 }
 
 
+// fallocate命令
+void SimpleFileSystem::cmd_fallocate(const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        std::cout << "用法: fallocate <文件路径> <字节数>" << std::endl;
+        return;
+    }
+
+    uint32_t length;
+    if (!parse_file_size(args[2], length)) {
+        std::cout << "无效的字节数: " << args[2] << "（上限 " << INODE_MAX_FILE_SIZE << "）" << std::endl;
+        return;
+    }
+
+    const int result = preallocate_file(args[1], length);
+
+    if (result == 0) {
+        std::cout << "预分配成功: " << args[1] << std::endl;
+    } else {
+        std::cout << "预分配失败，错误码: " << result << std::endl;
+    }
+}
+
+// truncate命令
+void SimpleFileSystem::cmd_truncate(const std::vector<std::string>& args) {
+    if (args.size() < 3) {
+        std::cout << "用法: truncate <文件路径> <字节数>" << std::endl;
+        return;
+    }
+
+    uint32_t size;
+    if (!parse_file_size(args[2], size)) {
+        std::cout << "无效的字节数: " << args[2] << "（上限 " << INODE_MAX_FILE_SIZE << "）" << std::endl;
+        return;
+    }
+
+    const int result = truncate_file(args[1], size);
+
+    if (result == 0) {
+        std::cout << "截断成功: " << args[1] << std::endl;
+    } else {
+        std::cout << "截断失败，错误码: " << result << std::endl;
+    }
+}
+
+// defrag命令
+void SimpleFileSystem::cmd_defrag(const std::vector<std::string>& args) {
+    uint32_t rate = DEFRAG_DEFAULT_RATE;
+    if (args.size() > 1 && !parse_uint(args[1], UINT32_MAX, rate)) {
+        std::cout << "用法: defrag [限速(块/秒), 0表示不限速]" << std::endl;
+        return;
+    }
+
+    DefragStats stats;
+    const int result = defragment(rate, stats);
+
+    if (result == 0) {
+        std::cout << "整理完成: 检查 " << stats.files_scanned << " 个文件, 搬迁 " << stats.files_moved
+                  << " 个, 复制 " << stats.blocks_moved << " 块" << std::endl;
+    } else {
+        std::cout << "整理失败，错误码: " << result << std::endl;
+    }
+}
+
 // help命令
 void SimpleFileSystem::cmd_help() {
     std::cout << "可用命令:" << std::endl;
@@ -795,10 +1165,14 @@ void SimpleFileSystem::cmd_help() {
     std::cout << "  touch <文件>           - 创建空文件" << std::endl;
     std::cout << "  cat <文件>             - 显示文件内容" << std::endl;
     std::cout << "  echo <内容> > <文件>    - 写入内容到文件" << std::endl;
+    std::cout << "  echo <内容> >> <文件>   - 追加内容到文件末尾" << std::endl;
     std::cout << "  rm <文件>              - 删除文件" << std::endl;
     std::cout << "  mkdir <目录>           - 创建目录" << std::endl;
     std::cout << "  rmdir <目录>           - 删除目录" << std::endl;
     std::cout << "  edit <文件>            - 编辑文件内容" << std::endl;
+    std::cout << "  fallocate <文件> <字节数> - 为文件预分配空间（不改变大小）" << std::endl;
+    std::cout << "  truncate <文件> <字节数> - 截断或扩大文件（扩大部分不占空间）" << std::endl;
+    std::cout << "  defrag [块/秒]         - 在线整理空闲空间" << std::endl;
     std::cout << "  help                  - 显示帮助信息" << std::endl;
     std::cout << "  exit                  - 退出" << std::endl;
 }
\ No newline at end of file
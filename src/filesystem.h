@@ -12,12 +12,15 @@
 #include <unordered_map>
 #include <mutex>
 #include <ctime>
+#include <functional>
 
 #include "core/disk.h"
 #include "core/bitmap.h"
 #include "core/inode.h"
 #include "core/directory.h"
 #include "core/cache.h"
+#include "core/superblock.h"
+#include "core/file_reader.h"
 
 class SimpleFileSystem {
 private:
@@ -25,6 +28,7 @@ private:
     std::unique_ptr<FreeBitmap> bitmap_;
     std::unique_ptr<CacheManager> cache_;
     std::unique_ptr<INodeManager> inode_manager_;
+    SuperBlock superblock_;     // 挂载时读入的超级块
 
     bool mounted_;
     std::string disk_file_;
@@ -37,7 +41,11 @@ private:
     // 内部辅助函数
     std::string normalize_path(const std::string& path);
     static bool is_valid_filename(const std::string& name);
+    static bool parse_uint(const std::string& text, uint32_t max_value, uint32_t& value);
+    static bool parse_file_size(const std::string& text, uint32_t& size);
     bool is_file_protected(const std::string& path);
+    std::string hot_set_path() const;
+    static SuperBlock make_superblock(const FreeBitmap& bitmap);
 
 public:
     SimpleFileSystem();
@@ -45,14 +53,27 @@ public:
 
     // 初始化和销毁
     bool format(const std::string& disk_file, size_t size_mb);
-    bool mount(const std::string& disk_file);
+    // allocator 选择连续块分配引擎，只影响内存中的索引，磁盘格式相同；
+    // concurrent 为true时位图分配器的单块与小段分配/释放走无锁路径（伙伴模式下不生效）
+    bool mount(const std::string& disk_file, AllocatorKind allocator = AllocatorKind::BITMAP,
+               bool concurrent = false);
     void unmount();
 
     // 文件操作
     int create_file(const std::string& normalized, const std::string& content = "");
     int delete_file(const std::string& normalized);
     int read_file(const std::string& normalized, std::string& content);
+    // 流式读取：按块把数据交给consumer（直接指向缓存页），consumer返回false时提前结束
+    int read_stream(const std::string& normalized, const std::function<bool(const char*, size_t)>& consumer);
     int write_file(const std::string& normalized, const std::string& content);
+    // 按偏移读写，只访问涉及的块
+    int read_at(const std::string& normalized, uint32_t offset, uint32_t length, std::string& content);
+    int write_at(const std::string& normalized, uint32_t offset, const std::string& data);
+    // 追加到文件末尾，文件不存在时创建
+    int append(const std::string& normalized, const std::string& data);
+    int preallocate_file(const std::string& normalized, uint32_t length);
+    int truncate_file(const std::string& normalized, uint32_t size);
+    int defragment(uint32_t blocks_per_second, DefragStats& stats);
 
     // 目录操作
     bool change_directory(const std::string& normalized);
@@ -88,6 +109,9 @@ public:
     void cmd_mkdir(const std::vector<std::string>& args);
     void cmd_rmdir(const std::vector<std::string>& args);
     void cmd_edit(const std::vector<std::string>& args);
+    void cmd_fallocate(const std::vector<std::string>& args);
+    void cmd_truncate(const std::vector<std::string>& args);
+    void cmd_defrag(const std::vector<std::string>& args);
     static void cmd_help();
 
 private:
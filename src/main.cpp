@@ -17,13 +17,25 @@ void print_welcome_message() {
     std::cout << "========================================\n";
 }
 
-int main() {
+int main(int argc, char* argv[]) {
     SimpleFileSystem fs;
 
+    // --buddy: 使用伙伴系统分配连续块
+    // --concurrent: 位图分配器的单块与小段分配/释放走无锁路径
+    AllocatorKind allocator = AllocatorKind::BITMAP;
+    bool concurrent = false;
+    for (int i = 1; i < argc; ++i) {
+        if (std::string(argv[i]) == "--buddy") {
+            allocator = AllocatorKind::BUDDY;
+        } else if (std::string(argv[i]) == "--concurrent") {
+            concurrent = true;
+        }
+    }
+
     std::cout << "正在检查虚拟磁盘文件...\n";
 
     // 步骤 1: 尝试挂载现有磁盘
-    if (fs.mount(DISK_FILE)) {
+    if (fs.mount(DISK_FILE, allocator, concurrent)) {
         std::cout << "已成功挂载现有虚拟磁盘！\n";
     } else {
         // 步骤 2: 挂载失败，则格式化新磁盘
@@ -35,7 +47,7 @@ int main() {
         std::cout << "虚拟磁盘格式化成功！\n";
 
         // 步骤 3: 格式化后，必须再次挂载才能使用
-        if (!fs.mount(DISK_FILE)) {
+        if (!fs.mount(DISK_FILE, allocator, concurrent)) {
             std::cerr << "错误：格式化后仍然无法挂载虚拟磁盘！\n";
             return 1;
         }
@@ -6,6 +6,8 @@
 #include <atomic>
 #include <memory>
 #include <shared_mutex>
+#include <thread>
+#include <functional>
 
 // 统一的锁类型定义
 using SimpleMutex = std::mutex;
@@ -103,6 +105,44 @@ public:
     }
 };
 
+// 分条计数器 - 各线程累加到各自缓存行上的分量，读取时求和
+// 读到的是各分量的近似快照，适合高频增减、低频读取的统计量
+class StripedCounter {
+private:
+    static constexpr size_t STRIPES = 16;
+    struct alignas(64) Stripe {
+        std::atomic<int64_t> value{0};
+    };
+    Stripe stripes_[STRIPES];
+
+    static size_t stripe_index() {
+        static thread_local const size_t index =
+            std::hash<std::thread::id>{}(std::this_thread::get_id()) % STRIPES;
+        return index;
+    }
+
+public:
+    void add(const int64_t delta) {
+        stripes_[stripe_index()].value.fetch_add(delta, std::memory_order_relaxed);
+    }
+
+    int64_t load() const {
+        int64_t total = 0;
+        for (const Stripe& stripe : stripes_) {
+            total += stripe.value.load(std::memory_order_relaxed);
+        }
+        return total;
+    }
+
+    // 重置为指定值（调用方需保证没有并发的 add）
+    void reset(const int64_t value) {
+        for (Stripe& stripe : stripes_) {
+            stripe.value.store(0, std::memory_order_relaxed);
+        }
+        stripes_[0].value.store(value, std::memory_order_relaxed);
+    }
+};
+
 // 锁管理器 - 用于统计和调试
 //TODO: 最后完成统计与调试部分
 class LockManager {